@@ -0,0 +1,395 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/resource.h>
+
+#include <opencv2/core.hpp>
+
+#include "plan_types.hpp"
+#include "plan_index.hpp"
+#include "plan_loader.hpp"
+#include "plan_raster.hpp"
+#include "camera_projection.hpp"
+#include "projection_math.hpp"
+#include "column_kernel.hpp"
+#include "frame_overlay.hpp"
+
+using namespace std;
+using namespace cv;
+
+#define BENCH_SECONDS 0.25  // Minimum run time of every measurement
+#define BENCH_MAX_SEGMENTS 1000000
+#define BENCH_LOOKUPS 4096  // Query positions, half of them on markers
+#define BENCH_FRAME_SEGMENTS 1000 // Plan of the frame benchmarks, the reference scan gets slow on larger plans
+#define BENCH_BITMAP_MAX_BYTES (256 * 1024 * 1024)
+#define BENCH_HASH_MAX_BYTES (256 * 1024 * 1024)
+
+// Camera pose of the frame benchmarks, start of VIDEO2
+#define BENCH_LATITUDE 48.378986
+#define BENCH_LONGITUDE 16.825719
+#define BENCH_DIRECTION 150
+#define BENCH_TILT 89
+
+static volatile long long benchSink;
+
+
+// Runs the function until BENCH_SECONDS are over, returns the seconds per call
+template<typename Function>
+static double benchSeconds(Function function)
+{
+  long long repetitions = 0;
+  auto begin = chrono::steady_clock::now();
+  double seconds;
+  do
+  {
+    function();
+    repetitions++;
+    seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+  } while(seconds < BENCH_SECONDS);
+  return seconds / repetitions;
+}
+
+
+static double peakMemoryMB()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;  // kB on Linux
+}
+
+
+static double megaBytes(size_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+
+// Random walks of segments with 1 to 20 micro-degree steps around the camera,
+// the area grows with the plan so the density stays about the same
+static void generateSyntheticPlan(int segmentCount, vector<GPS_Point> &gpsPoints)
+{
+  mt19937 generator(segmentCount);
+  int halfSize = max(300, (int) (sqrt((double) segmentCount) * 20));
+  uniform_int_distribution<int> position(-halfSize, halfSize);
+  uniform_int_distribution<int> step(-20, 20);
+  uniform_int_distribution<int> walkLength(1, 50);
+
+  gpsPoints.resize(segmentCount);
+  int latitude = 0;
+  int longitude = 0;
+  int walkLeft = 0;
+  for(int segmentCounter = 0; segmentCounter < segmentCount; segmentCounter++)
+  {
+    if(walkLeft-- <= 0)
+    {
+      latitude = position(generator);
+      longitude = position(generator);
+      walkLeft = walkLength(generator);
+    }
+    GPS_Point &gpsPoint = gpsPoints[segmentCounter];
+    gpsPoint.startLatitude = BENCH_LATITUDE + latitude * 1e-6;
+    gpsPoint.startLongitude = BENCH_LONGITUDE + longitude * 1e-6;
+    latitude = min(halfSize, max(-halfSize, latitude + step(generator)));
+    longitude = min(halfSize, max(-halfSize, longitude + step(generator)));
+    gpsPoint.endLatitude = BENCH_LATITUDE + latitude * 1e-6;
+    gpsPoint.endLongitude = BENCH_LONGITUDE + longitude * 1e-6;
+  }
+}
+
+
+static bool writePlanText(const string &fileName, const vector<GPS_Point> &gpsPoints, size_t &fileSize)
+{
+  FILE *file = fopen(fileName.c_str(), "w");
+  if(file == NULL)
+  {
+    cout << "Could not write " << fileName << endl;
+    return false;
+  }
+  for(size_t segmentCounter = 0; segmentCounter < gpsPoints.size(); segmentCounter++)
+  {
+    const GPS_Point &gpsPoint = gpsPoints[segmentCounter];
+    fprintf(file, "S:%.6f/%.6f\nE:%.6f/%.6f\n", gpsPoint.startLatitude, gpsPoint.startLongitude, gpsPoint.endLatitude, gpsPoint.endLongitude);
+  }
+  fileSize = ftell(file);
+  fclose(file);
+  return true;
+}
+
+
+// comparePositionToLineMark reads up to markingSize / 19 markers behind the
+// end, the copy is padded with markers no position can match
+static void padForReferenceScan(const vector<Line_Marking_Points> &lineMarks, vector<Line_Marking_Points> &padded)
+{
+  padded = lineMarks;
+  Line_Marking_Points sentinel;
+  sentinel.latitude = INT_MAX;
+  sentinel.longitude = INT_MAX;
+  padded.insert(padded.end(), lineMarks.size() / 19 + 1, sentinel);
+}
+
+
+static void makeQueries(const vector<Line_Marking_Points> &lineMarks, vector<Line_Marking_Points> &queries)
+{
+  mt19937 generator(1);
+  int minLatitude = INT_MAX, maxLatitude = INT_MIN, minLongitude = INT_MAX, maxLongitude = INT_MIN;
+  for(size_t markCounter = 0; markCounter < lineMarks.size(); markCounter++)
+  {
+    minLatitude = min(minLatitude, lineMarks[markCounter].latitude);
+    maxLatitude = max(maxLatitude, lineMarks[markCounter].latitude);
+    minLongitude = min(minLongitude, lineMarks[markCounter].longitude);
+    maxLongitude = max(maxLongitude, lineMarks[markCounter].longitude);
+  }
+  uniform_int_distribution<size_t> marker(0, lineMarks.size() - 1);
+  uniform_int_distribution<int> latitude(minLatitude, maxLatitude);
+  uniform_int_distribution<int> longitude(minLongitude, maxLongitude);
+
+  queries.resize(BENCH_LOOKUPS);
+  for(int queryCounter = 0; queryCounter < BENCH_LOOKUPS; queryCounter++)
+  {
+    if(queryCounter % 2 == 0)
+      queries[queryCounter] = lineMarks[marker(generator)];
+    else
+    {
+      queries[queryCounter].latitude = latitude(generator);
+      queries[queryCounter].longitude = longitude(generator);
+    }
+  }
+}
+
+
+// Nanoseconds per lookup over the query positions
+template<typename Lookup>
+static double benchLookup(const vector<Line_Marking_Points> &queries, Lookup lookup)
+{
+  double seconds = benchSeconds([&]()
+  {
+    long long matches = 0;
+    for(size_t queryCounter = 0; queryCounter < queries.size(); queryCounter++)
+      matches += lookup(queries[queryCounter].longitude, queries[queryCounter].latitude);
+    benchSink = matches;
+  });
+  return seconds * 1e9 / queries.size();
+}
+
+
+/*****************************/
+/*** Plan loading and sort ***/
+/*****************************/
+static void benchPlan(int segmentCount)
+{
+  vector<GPS_Point> gpsPoints;
+  generateSyntheticPlan(segmentCount, gpsPoints);
+
+  // Parser
+  string planFileName = (filesystem::temp_directory_path() / "bench_overlay_plan.txt").string();
+  size_t fileSize = 0;
+  if(!writePlanText(planFileName, gpsPoints, fileSize))
+    return;
+  vector<GPS_Point> loadedPoints;
+  double parseSeconds = benchSeconds([&]() { loadPlanFile(planFileName, loadedPoints); });
+  remove(planFileName.c_str());
+
+  // Rasterization and sort, the sorts work on a fresh copy every time
+  vector<Line_Marking_Points> rasterized;
+  double rasterizeSeconds = benchSeconds([&]() { rasterizePlan(gpsPoints.data(), gpsPoints.size(), rasterized); });
+  vector<Line_Marking_Points> lineMarks;
+  double copySeconds = benchSeconds([&]() { lineMarks = rasterized; });
+  double radixSeconds = benchSeconds([&]() { lineMarks = rasterized; sortUniqueLineMarks(lineMarks); }) - copySeconds;
+  vector<Line_Marking_Points> latitudeSorted;
+  double stdSortSeconds = benchSeconds([&]() { latitudeSorted = rasterized; sort(latitudeSorted.begin(), latitudeSorted.end(), lineMarkCompare); }) - copySeconds;
+
+  Plan_Index planIndex;
+  double indexSeconds = benchSeconds([&]() { buildPlanIndex(planIndex, lineMarks.data(), lineMarks.size(), BENCH_BITMAP_MAX_BYTES, BENCH_HASH_MAX_BYTES); });
+
+  cout << setw(9) << segmentCount << setw(10) << rasterized.size() << setw(9) << megaBytes(fileSize);
+  cout << setw(10) << parseSeconds * 1e3 << setw(10) << parseSeconds * 1e9 / segmentCount << setw(8) << megaBytes(fileSize) / parseSeconds;
+  cout << setw(10) << rasterizeSeconds * 1e3 << setw(10) << radixSeconds * 1e3 << setw(10) << stdSortSeconds * 1e3 << setw(10) << indexSeconds * 1e3;
+  cout << setw(8) << radixSeconds * 1e9 / rasterized.size() << setw(9) << megaBytes(lineMarks.size() * sizeof(Line_Marking_Points)) << setw(9) << peakMemoryMB() << endl;
+}
+
+
+/*******************/
+/*** Plan lookup ***/
+/*******************/
+static void benchLookups(int segmentCount)
+{
+  vector<GPS_Point> gpsPoints;
+  generateSyntheticPlan(segmentCount, gpsPoints);
+  vector<Line_Marking_Points> lineMarks;
+  rasterizePlan(gpsPoints.data(), gpsPoints.size(), lineMarks);
+  sortUniqueLineMarks(lineMarks);
+  vector<Line_Marking_Points> queries;
+  makeQueries(lineMarks, queries);
+  const Line_Marking_Points *lmp = lineMarks.data();
+  size_t markingSize = lineMarks.size();
+
+  cout << setw(9) << segmentCount << setw(10) << markingSize;
+
+  // The reference scan loops forever on less than 19 markers
+  if(markingSize >= 19)
+  {
+    vector<Line_Marking_Points> padded;
+    padForReferenceScan(lineMarks, padded);
+    cout << setw(12) << benchLookup(queries, [&](int east, int north) { return comparePositionToLineMark(east, north, padded.data(), markingSize); });
+  }
+  else
+    cout << setw(12) << "-";
+
+  Plan_Hash_Index hashIndex;
+  buildPlanHashIndex(hashIndex, lmp, markingSize);
+  cout << setw(9) << benchLookup(queries, [&](int east, int north) { return planHashIndexContains(hashIndex, east, north); });
+  cout << setw(9) << megaBytes((hashIndex.slotMask + 1) * sizeof(uint64_t));
+  hashIndex.slotStorage = vector<uint64_t>();
+
+  Plan_Bitmap_Index bitmapIndex;
+  if(buildPlanBitmapIndex(bitmapIndex, lmp, markingSize, BENCH_BITMAP_MAX_BYTES))
+  {
+    cout << setw(9) << benchLookup(queries, [&](int east, int north) { return planBitmapIndexContains(bitmapIndex, east, north); });
+    cout << setw(9) << megaBytes(bitmapIndex.bitStorage.size() * sizeof(uint64_t));
+  }
+  else
+    cout << setw(9) << "-" << setw(9) << "-";
+  bitmapIndex.bitStorage = vector<uint64_t>();
+
+  Plan_Sorted_Index sortedIndex;
+  sortedIndex.lmp = lmp;
+  sortedIndex.markingSize = markingSize;
+  cout << setw(9) << benchLookup(queries, [&](int east, int north) { return planSortedIndexContains(sortedIndex, east, north); });
+  cout << setw(9) << peakMemoryMB() << endl;
+}
+
+
+/******************************/
+/*** SOLUTION_1 / _2 frames ***/
+/******************************/
+struct Bench_Variant {
+  const char *name;
+  int planLookup;
+  int columnKernel;
+};
+
+
+// SOLUTION_1 only computes positions, without a use the compiler drops the
+// frame loop, the positions are summed up here
+static long long solution1Frame(const Camera_Geometry<Projection_Real> &cameraGeometry, const Projection_Pose<Projection_Real> &projectionPose)
+{
+  long long positionSum = 0;
+  for (int row = 1; row <= cameraGeometry.rowCount; row++)
+  {
+    for (int column = 1; column <= cameraGeometry.frameWidth; column++)
+    {
+      Projection_Real positionEast;
+      Projection_Real positionNorth;
+      projectPixelSolution1(cameraGeometry, projectionPose, row, column, positionEast, positionNorth);
+      positionSum += (int) positionEast + (int) positionNorth;
+    }
+  }
+  return positionSum;
+}
+
+
+static void printFrameResult(int frameHeight, const char *name, double pixels, double seconds)
+{
+  cout << setw(6) << frameHeight << "p" << "  " << left << setw(23) << name << right;
+  cout << setw(10) << (long long) pixels << setw(10) << seconds * 1e3 << setw(10) << seconds * 1e9 / pixels << setw(11) << pixels / seconds / 1e6 << setw(9) << peakMemoryMB() << endl;
+}
+
+static void benchFrames(int frameWidth, int frameHeight, const vector<GPS_Point> &gpsPoints, const vector<Line_Marking_Points> &lineMarks, const vector<Line_Marking_Points> &padded, const Plan_Index &planIndex)
+{
+  static const Bench_Variant variants[] = {
+    {"solution2 reference", OVERLAY_LOOKUP_REFERENCE, OVERLAY_KERNEL_NONE},
+    {"solution2 index", OVERLAY_LOOKUP_INDEX, OVERLAY_KERNEL_NONE},
+    {"solution2 simd", OVERLAY_LOOKUP_INDEX, OVERLAY_KERNEL_SIMD},
+    {"solution2 fixed point", OVERLAY_LOOKUP_INDEX, OVERLAY_KERNEL_FIXED_POINT}
+  };
+
+  Overlay_Context context;
+  context.settings.solution1 = false;
+  context.settings.solution2 = true;
+  context.settings.solution3 = false;
+  context.settings.solution4 = false;
+  context.settings.rowThreads = 1;
+  context.settings.mask = false;
+  context.gpsPoint = gpsPoints.data();
+  context.dataCounter = gpsPoints.size();
+  context.lineMark = padded.data();
+  context.markingSize = lineMarks.size();
+  context.planIndex = &planIndex;
+  context.tilt = BENCH_TILT;
+  buildCameraGeometry(context.cameraGeometry, BENCH_TILT, frameWidth, frameHeight);
+
+  Camera_Pose pose;
+  pose.latitude = BENCH_LATITUDE;
+  pose.longitude = BENCH_LONGITUDE;
+  pose.direction = BENCH_DIRECTION;
+  pose.tilt = BENCH_TILT;
+
+  Mat frame(frameHeight, frameWidth, CV_8UC3, Scalar(0, 0, 0));
+  double pixels = (double) context.cameraGeometry.rowCount * frameWidth;
+
+  Projection_Pose<Projection_Real> projectionPose;
+  buildProjectionPose(projectionPose, pose.latitude, pose.longitude, pose.direction);
+  printFrameResult(frameHeight, "solution1", pixels, benchSeconds([&]() { benchSink = solution1Frame(context.cameraGeometry, projectionPose); }));
+
+  for(size_t variantCounter = 0; variantCounter < sizeof(variants) / sizeof(variants[0]); variantCounter++)
+  {
+    const Bench_Variant &variant = variants[variantCounter];
+    context.settings.planLookup = variant.planLookup;
+    context.settings.columnKernel = variant.columnKernel;
+    Overlay_Worker worker;
+    initOverlayWorker(worker, context);
+
+    printFrameResult(frameHeight, variant.name, pixels, benchSeconds([&]() { overlayFrame(frame, context, pose, worker, 0); }));
+  }
+}
+
+
+/********************/
+/*** Main routine ***/
+/********************/
+int main(int argc, char **argv)
+{
+  int maxSegments = BENCH_MAX_SEGMENTS;
+  if(argc > 2 || (argc == 2 && (maxSegments = atoi(argv[1])) < 1))
+  {
+    cout << "Usage: " << argv[0] << " [max segments, default " << BENCH_MAX_SEGMENTS << "]" << endl;
+    return -1;
+  }
+  cout << fixed << setprecision(2);
+  cout << "Column kernel: " << columnKernelName() << ", OpenCV threads: " << getNumThreads() << endl;
+
+  cout << endl << "Plan loading, rasterization and sort (ms, ns per segment / marker, MB)" << endl;
+  cout << setw(9) << "segments" << setw(10) << "markers" << setw(9) << "file" << setw(10) << "parse" << setw(10) << "ns/seg" << setw(8) << "MB/s";
+  cout << setw(10) << "raster" << setw(10) << "radix" << setw(10) << "std::sort" << setw(10) << "index" << setw(8) << "ns/mark" << setw(9) << "markers" << setw(9) << "peak" << endl;
+  for(int segmentCount = 1; segmentCount <= maxSegments; segmentCount *= 10)
+    benchPlan(segmentCount);
+
+  cout << endl << "Plan lookup (ns per lookup, MB)" << endl;
+  cout << setw(9) << "segments" << setw(10) << "markers" << setw(12) << "reference" << setw(9) << "hash" << setw(9) << "hash MB";
+  cout << setw(9) << "bitmap" << setw(9) << "bitmapMB" << setw(9) << "sorted" << setw(9) << "peak" << endl;
+  for(int segmentCount = 1; segmentCount <= maxSegments; segmentCount *= 10)
+    benchLookups(segmentCount);
+
+  vector<GPS_Point> gpsPoints;
+  generateSyntheticPlan(BENCH_FRAME_SEGMENTS, gpsPoints);
+  vector<Line_Marking_Points> lineMarks;
+  rasterizePlan(gpsPoints.data(), gpsPoints.size(), lineMarks);
+  sortUniqueLineMarks(lineMarks);
+  vector<Line_Marking_Points> padded;
+  padForReferenceScan(lineMarks, padded);
+  Plan_Index planIndex;
+  buildPlanIndex(planIndex, lineMarks.data(), lineMarks.size(), BENCH_BITMAP_MAX_BYTES, BENCH_HASH_MAX_BYTES);
+
+  cout << endl << "Frames, " << BENCH_FRAME_SEGMENTS << " segments (processed pixels, ms per frame, ns per pixel, Mpixel/s, MB)" << endl;
+  cout << setw(7) << "frame" << "  " << left << setw(23) << "variant" << right << setw(10) << "pixels" << setw(10) << "ms" << setw(10) << "ns/pixel" << setw(11) << "Mpixel/s" << setw(9) << "peak" << endl;
+  benchFrames(640, 480, gpsPoints, lineMarks, padded, planIndex);
+  benchFrames(1280, 720, gpsPoints, lineMarks, padded, planIndex);
+  benchFrames(1920, 1080, gpsPoints, lineMarks, padded, planIndex);
+  return 0;
+}
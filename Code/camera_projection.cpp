@@ -0,0 +1,214 @@
+#include <math.h>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "camera_projection.hpp"
+
+using namespace std;
+using namespace cv;
+
+#define MM_PER_DEGREE (111.32 * 1000000)
+
+// Plan segment in mm relative to the camera, clipped to the processed rows
+struct Ground_Segment {
+  long double startEast;
+  long double startNorth;
+  long double endEast;
+  long double endNorth;
+  long double startForward;
+  long double startLateral;
+  long double endForward;
+  long double endLateral;
+};
+
+// Everything of the clipping that only depends on the pose, built once per frame
+struct Ground_Clip {
+  long double sinDirection;
+  long double cosDirection;
+  long double forwardNear;  // Ground distance of the lowest row
+  long double forwardFar; // Of the highest processed row
+};
+
+
+long double degreeToRadiant(long double degree)
+{
+  return (degree * (long double) PI / 180);
+}
+
+
+long double baselineAngleOfRow(int row, double tilt, int frameHeight)
+{
+  return (tilt + ((long double) AOV_V / 2)) - (((long double) frameHeight - (row - 1)) / (long double) frameHeight) * (long double) AOV_V;
+}
+
+
+// Half width of the view per mm of forward distance
+static const long double sidelineTangentOfView = tan(degreeToRadiant((long double) AOV_H / 2));
+
+
+static void buildGroundClip(const Camera_Pose &pose, Ground_Clip &clip)
+{
+  clip.sinDirection = sin(degreeToRadiant(pose.direction));
+  clip.cosDirection = cos(degreeToRadiant(pose.direction));
+
+  long double nearAngle = pose.tilt - (long double) AOV_V / 2;
+  long double farAngle = min(pose.tilt + (long double) AOV_V / 2, (long double) MAX_BASELINE_ANGLE);
+  clip.forwardNear = tan(degreeToRadiant(nearAngle)) * (long double) HEIGHT;
+  clip.forwardFar = tan(degreeToRadiant(farAngle)) * (long double) HEIGHT;
+}
+
+
+// Transforms a plan segment into the camera frame and clips it to the ground
+// range between the first and the last processed row. Returns false if
+// nothing of the segment is left.
+static bool clipSegmentToGround(const GPS_Point &gpsPoint, const Camera_Pose &pose, const Ground_Clip &clip, Ground_Segment &segment)
+{
+  long double startEast = (gpsPoint.startLongitude - pose.longitude) * MM_PER_DEGREE;
+  long double startNorth = (gpsPoint.startLatitude - pose.latitude) * MM_PER_DEGREE;
+  long double endEast = (gpsPoint.endLongitude - pose.longitude) * MM_PER_DEGREE;
+  long double endNorth = (gpsPoint.endLatitude - pose.latitude) * MM_PER_DEGREE;
+
+  long double startForward = startEast * clip.sinDirection + startNorth * clip.cosDirection;
+  long double startLateral = startEast * clip.cosDirection - startNorth * clip.sinDirection;
+  long double endForward = endEast * clip.sinDirection + endNorth * clip.cosDirection;
+  long double endLateral = endEast * clip.cosDirection - endNorth * clip.sinDirection;
+
+  // t runs from the start (0) to the end (1) of the segment
+  long double tBegin = 0;
+  long double tEnd = 1;
+  long double deltaForward = endForward - startForward;
+  if(deltaForward == 0)
+  {
+    if((startForward < clip.forwardNear) | (startForward > clip.forwardFar))
+      return false;
+  }
+  else
+  {
+    long double tNear = (clip.forwardNear - startForward) / deltaForward;
+    long double tFar = (clip.forwardFar - startForward) / deltaForward;
+    tBegin = max(tBegin, min(tNear, tFar));
+    tEnd = min(tEnd, max(tNear, tFar));
+    if(tBegin >= tEnd)
+      return false;
+  }
+
+  segment.startEast = startEast + tBegin * (endEast - startEast);
+  segment.startNorth = startNorth + tBegin * (endNorth - startNorth);
+  segment.endEast = startEast + tEnd * (endEast - startEast);
+  segment.endNorth = startNorth + tEnd * (endNorth - startNorth);
+  segment.startForward = startForward + tBegin * deltaForward;
+  segment.startLateral = startLateral + tBegin * (endLateral - startLateral);
+  segment.endForward = startForward + tEnd * deltaForward;
+  segment.endLateral = startLateral + tEnd * (endLateral - startLateral);
+  return true;
+}
+
+
+Point2d projectGroundToImage(long double forward, long double lateral, double tilt, int frameWidth, int frameHeight)
+{
+  // Row: baselinePixelAngle = (tilt + AOV_V / 2) - ((frameHeight - (row - 1)) / frameHeight) * AOV_V
+  long double baselinePixelAngle = atan(forward / (long double) HEIGHT) * 180 / (long double) PI;
+  long double imageRow = (long double) frameHeight * ((tilt + (long double) AOV_V / 2) - baselinePixelAngle) / (long double) AOV_V - 1;
+
+  // Column: linear between the left and right point of view of this row
+  long double halfWidth = sidelineTangentOfView * forward;
+  long double imageColumn = (lateral + halfWidth) * (long double) frameWidth / (2 * halfWidth);
+
+  return Point2d((double) imageColumn, (double) imageRow);
+}
+
+
+void drawPlanForwardProjected(Mat &frame, const GPS_Point *gpsPoint, int dataCounter, const Camera_Pose &pose)
+{
+  Ground_Clip clip;
+  buildGroundClip(pose, clip);
+
+  vector<vector<Point> > polylineSet;
+  for(int lineCounter = 0; lineCounter < dataCounter; lineCounter++)
+  {
+    Ground_Segment segment;
+    if(!clipSegmentToGround(gpsPoint[lineCounter], pose, clip, segment))
+      continue;
+
+    vector<Point> polyline;
+    for(int stepCounter = 0; stepCounter <= FORWARD_PROJECTION_STEPS; stepCounter++)
+    {
+      long double t = (long double) stepCounter / FORWARD_PROJECTION_STEPS;
+      long double forward = segment.startForward + t * (segment.endForward - segment.startForward);
+      long double lateral = segment.startLateral + t * (segment.endLateral - segment.startLateral);
+      Point2d pixel = projectGroundToImage(forward, lateral, pose.tilt, frame.cols, frame.rows);
+      polyline.push_back(Point(cvRound(pixel.x), cvRound(pixel.y)));
+    }
+    polylineSet.push_back(polyline);
+  }
+
+  polylines(frame, polylineSet, false, Scalar(0, 0, 255));
+}
+
+
+static Mat groundHomographyOfClip(const Ground_Clip &clip, double tilt, int frameWidth, int frameHeight, int rowCount)
+{
+  // Highest row SOLUTION_2 still processes, the lowest one if none is
+  int topRow = max(rowCount, 1);
+  int cornerRows[2] = {1, topRow};
+  Point2f groundCorners[4];
+  Point2f imageCorners[4];
+  for(int cornerCounter = 0; cornerCounter < 2; cornerCounter++)
+  {
+    int row = cornerRows[cornerCounter];
+    long double distanceOfBaseline = tan(degreeToRadiant(baselineAngleOfRow(row, tilt, frameHeight))) * (long double) HEIGHT;
+    long double distanceOfSideline = sidelineTangentOfView * distanceOfBaseline;
+    long double centerEast = clip.sinDirection * distanceOfBaseline;
+    long double centerNorth = clip.cosDirection * distanceOfBaseline;
+
+    // Left point of view is column 0, right point of view is column frameWidth
+    groundCorners[2 * cornerCounter] = Point2f(centerEast - clip.cosDirection * distanceOfSideline, centerNorth + clip.sinDirection * distanceOfSideline);
+    groundCorners[2 * cornerCounter + 1] = Point2f(centerEast + clip.cosDirection * distanceOfSideline, centerNorth - clip.sinDirection * distanceOfSideline);
+    imageCorners[2 * cornerCounter] = Point2f(0, frameHeight - row);
+    imageCorners[2 * cornerCounter + 1] = Point2f(frameWidth, frameHeight - row);
+  }
+
+  return getPerspectiveTransform(groundCorners, imageCorners);
+}
+
+
+Mat computeGroundHomography(const Camera_Pose &pose, int frameWidth, int frameHeight, int rowCount)
+{
+  Ground_Clip clip;
+  buildGroundClip(pose, clip);
+  return groundHomographyOfClip(clip, pose.tilt, frameWidth, frameHeight, rowCount);
+}
+
+
+void drawPlanHomography(Mat &frame, const GPS_Point *gpsPoint, int dataCounter, const Camera_Pose &pose, int rowCount)
+{
+  Ground_Clip clip;
+  buildGroundClip(pose, clip);
+  Mat homography = groundHomographyOfClip(clip, pose.tilt, frame.cols, frame.rows, rowCount);
+
+  // Ground points are kept relative to the camera in mm, absolute degrees
+  // would not survive the float conversion
+  vector<Point2f> groundPoints;
+  groundPoints.reserve(2 * dataCounter);
+  for(int lineCounter = 0; lineCounter < dataCounter; lineCounter++)
+  {
+    Ground_Segment segment;
+    if(!clipSegmentToGround(gpsPoint[lineCounter], pose, clip, segment))
+      continue;
+    groundPoints.push_back(Point2f(segment.startEast, segment.startNorth));
+    groundPoints.push_back(Point2f(segment.endEast, segment.endNorth));
+  }
+  if(groundPoints.empty())
+    return;
+
+  vector<Point2f> imagePoints;
+  perspectiveTransform(groundPoints, imagePoints, homography);
+  for(size_t pointCounter = 0; pointCounter < imagePoints.size(); pointCounter += 2)
+  {
+    Point start(cvRound(imagePoints[pointCounter].x), cvRound(imagePoints[pointCounter].y));
+    Point end(cvRound(imagePoints[pointCounter + 1].x), cvRound(imagePoints[pointCounter + 1].y));
+    line(frame, start, end, Scalar(0, 0, 255));
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef CAMERA_PROJECTION_HPP
+#define CAMERA_PROJECTION_HPP
+
+#include <opencv2/core.hpp>
+
+#include "plan_types.hpp"
+
+#define AOV_V 31  // AngleOfView_Veritically
+#define AOV_H 67  // AngleOfView_Horizontally
+#define HEIGHT 1400 // Measurement in mm, height over ground in wich video was captured
+#define PI 3.14159265
+
+#define MAX_BASELINE_ANGLE 87 // Rows above this angle are not processed, the distance is irrelevant
+#define FORWARD_PROJECTION_STEPS 16 // Polyline pieces per plan segment, rows are not linear in distance
+
+struct Camera_Pose {
+  long double latitude;
+  long double longitude;
+  double direction;
+  double tilt;
+};
+
+
+long double degreeToRadiant(long double degree);
+
+// Angle between the vertical and the ground seen by an image row, row 1 is the bottom row
+long double baselineAngleOfRow(int row, double tilt, int frameHeight);
+
+
+/*************************************************/
+/*** Forward projection of plan into the image ***/
+/*************************************************/
+// Inverse of the SOLUTION_2 model. Ground offsets in mm from the camera are
+// split into the distance along the viewing direction (forward) and across
+// it (lateral, positive to the right). Returns the continuous image
+// position, column and row as drawn by SOLUTION_2.
+cv::Point2d projectGroundToImage(long double forward, long double lateral, double tilt, int frameWidth, int frameHeight);
+
+// Draws every plan segment that lies in the processed ground area
+void drawPlanForwardProjected(cv::Mat &frame, const GPS_Point *gpsPoint, int dataCounter, const Camera_Pose &pose);
+
+
+
+/*********************************************/
+/*** Ground homography of SOLUTION_2 model ***/
+/*********************************************/
+// Maps ground offsets in mm from the camera (east, north) to image pixels.
+// Built from the left and right point of view of the lowest and the highest
+// processed row, the ground is treated as flat. rowCount is the one of the
+// Camera_Geometry built for the tilt of the pose.
+cv::Mat computeGroundHomography(const Camera_Pose &pose, int frameWidth, int frameHeight, int rowCount);
+
+// Draws every plan segment with one perspectiveTransform call for all endpoints
+void drawPlanHomography(cv::Mat &frame, const GPS_Point *gpsPoint, int dataCounter, const Camera_Pose &pose, int rowCount);
+
+#endif /* CAMERA_PROJECTION_HPP */
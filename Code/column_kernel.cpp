@@ -0,0 +1,256 @@
+#include <math.h>
+#include <memory>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define COLUMN_KERNEL_X86 1
+#else
+  #define COLUMN_KERNEL_X86 0
+#endif
+
+#include "column_kernel.hpp"
+
+using namespace std;
+
+
+void allocateColumnKernelRow(Column_Kernel_Row &row, int frameWidth)
+{
+  size_t paddedWidth = ((frameWidth + COLUMN_KERNEL_BATCH - 1) / COLUMN_KERNEL_BATCH) * COLUMN_KERNEL_BATCH;
+  size_t alignmentInts = COLUMN_KERNEL_ALIGNMENT / sizeof(int);
+  row.width = frameWidth;
+  row.positionStorage.assign(2 * paddedWidth + 2 * alignmentInts, 0);
+  row.matchStorage.assign(paddedWidth + COLUMN_KERNEL_ALIGNMENT, 0);
+
+  void *storage = &row.positionStorage[0];
+  size_t space = row.positionStorage.size() * sizeof(int);
+  row.east = (int *) align(COLUMN_KERNEL_ALIGNMENT, paddedWidth * sizeof(int), storage, space);
+  row.north = row.east + paddedWidth;   // paddedWidth is a multiple of the alignment
+
+  storage = &row.matchStorage[0];
+  space = row.matchStorage.size();
+  row.match = (unsigned char *) align(COLUMN_KERNEL_ALIGNMENT, paddedWidth, storage, space);
+}
+
+
+/*** Scalar fallback ***/
+static void computeRowPositionsScalar(double longitudeLeftPoint, double latitudeLeftPoint, double steppingWidthEast, double steppingWidthNorth, Column_Kernel_Row &row)
+{
+  for (int column = 1; column <= row.width; column++)
+  {
+    row.east[column - 1] = (int)((longitudeLeftPoint + column * steppingWidthEast) * 1000000);
+    row.north[column - 1] = (int)((latitudeLeftPoint + column * steppingWidthNorth) * 1000000);
+  }
+}
+
+static void matchRowPositionsScalar(const Plan_Index &index, Column_Kernel_Row &row)
+{
+  for (int pixel = 0; pixel < row.width; pixel++)
+    row.match[pixel] = planIndexContains(index, row.east[pixel], row.north[pixel]);
+}
+
+
+#if COLUMN_KERNEL_X86
+/*** SSE4.1 ***/
+__attribute__((target("sse4.1")))
+static void computeRowPositionsSSE4(double longitudeLeftPoint, double latitudeLeftPoint, double steppingWidthEast, double steppingWidthNorth, Column_Kernel_Row &row)
+{
+  const __m128d scale = _mm_set1_pd(1000000);
+  const __m128d columnStep = _mm_set1_pd(2);
+  const __m128d leftEast = _mm_set1_pd(longitudeLeftPoint);
+  const __m128d leftNorth = _mm_set1_pd(latitudeLeftPoint);
+  const __m128d stepEast = _mm_set1_pd(steppingWidthEast);
+  const __m128d stepNorth = _mm_set1_pd(steppingWidthNorth);
+  __m128d column = _mm_set_pd(2, 1);
+
+  for (int pixel = 0; pixel < row.width; pixel += 4)
+  {
+    __m128d nextColumn = _mm_add_pd(column, columnStep);
+    __m128i eastLow = _mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(leftEast, _mm_mul_pd(column, stepEast)), scale));
+    __m128i eastHigh = _mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(leftEast, _mm_mul_pd(nextColumn, stepEast)), scale));
+    __m128i northLow = _mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(leftNorth, _mm_mul_pd(column, stepNorth)), scale));
+    __m128i northHigh = _mm_cvttpd_epi32(_mm_mul_pd(_mm_add_pd(leftNorth, _mm_mul_pd(nextColumn, stepNorth)), scale));
+    _mm_store_si128((__m128i *) (row.east + pixel), _mm_unpacklo_epi64(eastLow, eastHigh));
+    _mm_store_si128((__m128i *) (row.north + pixel), _mm_unpacklo_epi64(northLow, northHigh));
+    column = _mm_add_pd(nextColumn, columnStep);
+  }
+}
+
+__attribute__((target("sse4.1")))
+static void matchRowPositionsSSE4(const Plan_Index &index, Column_Kernel_Row &row)
+{
+  if(index.type != PLAN_INDEX_BITMAP)
+  {
+    matchRowPositionsScalar(index, row);
+    return;
+  }
+
+  // Offsets and range test in vector registers, the bitmap words are loaded per lane
+  const Plan_Bitmap_Index &bitmap = index.bitmap;
+  const uint32_t *words = (const uint32_t *) bitmap.bits;
+  const __m128i bias = _mm_set1_epi32(0x80000000);
+  const __m128i minLatitude = _mm_set1_epi32(bitmap.minLatitude);
+  const __m128i minLongitude = _mm_set1_epi32(bitmap.minLongitude);
+  const __m128i latitudeCells = _mm_xor_si128(_mm_set1_epi32(bitmap.latitudeCells), bias);
+  const __m128i longitudeCells = _mm_xor_si128(_mm_set1_epi32(bitmap.longitudeCells), bias);
+  const __m128i wordsPerRow = _mm_set1_epi32(2 * bitmap.wordsPerRow);
+  alignas(16) uint32_t wordIndex[4];
+  alignas(16) uint32_t bitIndex[4];
+  alignas(16) int32_t inRange[4];
+
+  for (int pixel = 0; pixel < row.width; pixel += 4)
+  {
+    __m128i latitudeOffset = _mm_sub_epi32(_mm_load_si128((const __m128i *) (row.north + pixel)), minLatitude);
+    __m128i longitudeOffset = _mm_sub_epi32(_mm_load_si128((const __m128i *) (row.east + pixel)), minLongitude);
+    __m128i mask = _mm_and_si128(_mm_cmpgt_epi32(latitudeCells, _mm_xor_si128(latitudeOffset, bias)),
+                                 _mm_cmpgt_epi32(longitudeCells, _mm_xor_si128(longitudeOffset, bias)));
+    _mm_store_si128((__m128i *) wordIndex, _mm_add_epi32(_mm_mullo_epi32(latitudeOffset, wordsPerRow), _mm_srli_epi32(longitudeOffset, 5)));
+    _mm_store_si128((__m128i *) bitIndex, _mm_and_si128(longitudeOffset, _mm_set1_epi32(31)));
+    _mm_store_si128((__m128i *) inRange, mask);
+    for (int lane = 0; lane < 4; lane++)
+      row.match[pixel + lane] = inRange[lane] ? (words[wordIndex[lane]] >> bitIndex[lane]) & 1 : 0;
+  }
+}
+
+
+/*** AVX2 ***/
+__attribute__((target("avx2")))
+static void computeRowPositionsAVX2(double longitudeLeftPoint, double latitudeLeftPoint, double steppingWidthEast, double steppingWidthNorth, Column_Kernel_Row &row)
+{
+  const __m256d scale = _mm256_set1_pd(1000000);
+  const __m256d columnStep = _mm256_set1_pd(4);
+  const __m256d leftEast = _mm256_set1_pd(longitudeLeftPoint);
+  const __m256d leftNorth = _mm256_set1_pd(latitudeLeftPoint);
+  const __m256d stepEast = _mm256_set1_pd(steppingWidthEast);
+  const __m256d stepNorth = _mm256_set1_pd(steppingWidthNorth);
+  __m256d column = _mm256_set_pd(4, 3, 2, 1);
+
+  for (int pixel = 0; pixel < row.width; pixel += 8)
+  {
+    // Separate multiply and add, a fused multiply-add would round differently than the scalar kernel
+    __m256d nextColumn = _mm256_add_pd(column, columnStep);
+    __m128i eastLow = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(leftEast, _mm256_mul_pd(column, stepEast)), scale));
+    __m128i eastHigh = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(leftEast, _mm256_mul_pd(nextColumn, stepEast)), scale));
+    __m128i northLow = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(leftNorth, _mm256_mul_pd(column, stepNorth)), scale));
+    __m128i northHigh = _mm256_cvttpd_epi32(_mm256_mul_pd(_mm256_add_pd(leftNorth, _mm256_mul_pd(nextColumn, stepNorth)), scale));
+    _mm256_store_si256((__m256i *) (row.east + pixel), _mm256_inserti128_si256(_mm256_castsi128_si256(eastLow), eastHigh, 1));
+    _mm256_store_si256((__m256i *) (row.north + pixel), _mm256_inserti128_si256(_mm256_castsi128_si256(northLow), northHigh, 1));
+    column = _mm256_add_pd(nextColumn, columnStep);
+  }
+}
+
+__attribute__((target("avx2")))
+static void matchRowPositionsAVX2(const Plan_Index &index, Column_Kernel_Row &row)
+{
+  if(index.type != PLAN_INDEX_BITMAP)
+  {
+    matchRowPositionsScalar(index, row);
+    return;
+  }
+
+  // The 64 bit bitmap words are read as pairs of little endian 32 bit words
+  const Plan_Bitmap_Index &bitmap = index.bitmap;
+  const int *words = (const int *) bitmap.bits;
+  const __m256i bias = _mm256_set1_epi32(0x80000000);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i minLatitude = _mm256_set1_epi32(bitmap.minLatitude);
+  const __m256i minLongitude = _mm256_set1_epi32(bitmap.minLongitude);
+  const __m256i latitudeCells = _mm256_xor_si256(_mm256_set1_epi32(bitmap.latitudeCells), bias);
+  const __m256i longitudeCells = _mm256_xor_si256(_mm256_set1_epi32(bitmap.longitudeCells), bias);
+  const __m256i wordsPerRow = _mm256_set1_epi32(2 * bitmap.wordsPerRow);
+
+  for (int pixel = 0; pixel < row.width; pixel += 8)
+  {
+    __m256i latitudeOffset = _mm256_sub_epi32(_mm256_load_si256((const __m256i *) (row.north + pixel)), minLatitude);
+    __m256i longitudeOffset = _mm256_sub_epi32(_mm256_load_si256((const __m256i *) (row.east + pixel)), minLongitude);
+    __m256i mask = _mm256_and_si256(_mm256_cmpgt_epi32(latitudeCells, _mm256_xor_si256(latitudeOffset, bias)),
+                                    _mm256_cmpgt_epi32(longitudeCells, _mm256_xor_si256(longitudeOffset, bias)));
+    __m256i wordIndex = _mm256_add_epi32(_mm256_mullo_epi32(latitudeOffset, wordsPerRow), _mm256_srli_epi32(longitudeOffset, 5));
+
+    // Lanes outside of the bounding box are not loaded and stay 0
+    __m256i word = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), words, wordIndex, mask, 4);
+    __m256i bit = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(longitudeOffset, _mm256_set1_epi32(31))), one);
+
+    __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(bit), _mm256_extracti128_si256(bit, 1));
+    _mm_storel_epi64((__m128i *) (row.match + pixel), _mm_packus_epi16(packed, packed));
+  }
+}
+#endif /* COLUMN_KERNEL_X86 */
+
+
+/*** Fixed point stepping ***/
+static inline int64_t toFixedPoint(long double microDegrees)
+{
+  return llroundl(microDegrees * (long double) ((int64_t) 1 << FIXED_POINT_FRACTION_BITS));
+}
+
+static inline int truncateFixedPoint(int64_t position)
+{
+  // Arithmetic shift rounds down, negative positions with a fraction need one more
+  const int64_t fractionMask = ((int64_t) 1 << FIXED_POINT_FRACTION_BITS) - 1;
+  return (int)((position + ((position >> 63) & fractionMask)) >> FIXED_POINT_FRACTION_BITS);
+}
+
+void computeRowPositionsFixedPoint(long double longitudeLeftPoint, long double latitudeLeftPoint, long double steppingWidthEast, long double steppingWidthNorth, Column_Kernel_Row &row)
+{
+  int64_t stepEast = toFixedPoint(steppingWidthEast * 1000000);
+  int64_t stepNorth = toFixedPoint(steppingWidthNorth * 1000000);
+  int64_t positionEast = toFixedPoint(longitudeLeftPoint * 1000000) + stepEast;   // column 1
+  int64_t positionNorth = toFixedPoint(latitudeLeftPoint * 1000000) + stepNorth;
+
+  for (int pixel = 0; pixel < row.width; pixel++)
+  {
+    row.east[pixel] = truncateFixedPoint(positionEast);
+    row.north[pixel] = truncateFixedPoint(positionNorth);
+    positionEast += stepEast;
+    positionNorth += stepNorth;
+  }
+}
+
+
+/*** Run time dispatch ***/
+int columnKernelLevel()
+{
+  #if COLUMN_KERNEL_X86
+    static const int level = __builtin_cpu_supports("avx2") ? COLUMN_KERNEL_AVX2 :
+                             __builtin_cpu_supports("sse4.1") ? COLUMN_KERNEL_SSE4 : COLUMN_KERNEL_SCALAR;
+    return level;
+  #else
+    return COLUMN_KERNEL_SCALAR;
+  #endif
+}
+
+
+const char *columnKernelName()
+{
+  switch(columnKernelLevel())
+  {
+    case COLUMN_KERNEL_AVX2: return "AVX2";
+    case COLUMN_KERNEL_SSE4: return "SSE4.1";
+    default: return "scalar";
+  }
+}
+
+
+void computeRowPositions(double longitudeLeftPoint, double latitudeLeftPoint, double steppingWidthEast, double steppingWidthNorth, Column_Kernel_Row &row)
+{
+  #if COLUMN_KERNEL_X86
+    if(columnKernelLevel() == COLUMN_KERNEL_AVX2)
+      return computeRowPositionsAVX2(longitudeLeftPoint, latitudeLeftPoint, steppingWidthEast, steppingWidthNorth, row);
+    if(columnKernelLevel() == COLUMN_KERNEL_SSE4)
+      return computeRowPositionsSSE4(longitudeLeftPoint, latitudeLeftPoint, steppingWidthEast, steppingWidthNorth, row);
+  #endif
+  computeRowPositionsScalar(longitudeLeftPoint, latitudeLeftPoint, steppingWidthEast, steppingWidthNorth, row);
+}
+
+
+void matchRowPositions(const Plan_Index &index, Column_Kernel_Row &row)
+{
+  #if COLUMN_KERNEL_X86
+    if(columnKernelLevel() == COLUMN_KERNEL_AVX2)
+      return matchRowPositionsAVX2(index, row);
+    if(columnKernelLevel() == COLUMN_KERNEL_SSE4)
+      return matchRowPositionsSSE4(index, row);
+  #endif
+  matchRowPositionsScalar(index, row);
+}
@@ -0,0 +1,62 @@
+#ifndef COLUMN_KERNEL_HPP
+#define COLUMN_KERNEL_HPP
+
+#include <vector>
+
+#include "plan_index.hpp"
+
+/****************************************/
+/*** Vectorized SOLUTION_2 row kernel ***/
+/****************************************/
+// Computes the micro-degree position of every pixel of a row and tests it
+// against the plan index, 8 pixels at a time with AVX2, 4 with SSE4.1 or
+// one by one with the scalar fallback. The instruction set is picked at run
+// time on the first call.
+//
+// Positions are computed in double as (leftPoint + column * steppingWidth) * 1000000
+// with the same truncation as the long double reference. All three kernels
+// give identical results, they may differ from the long double reference by
+// one micro-degree where a position lies within rounding distance of an
+// integer.
+#define COLUMN_KERNEL_SCALAR 0
+#define COLUMN_KERNEL_SSE4 1
+#define COLUMN_KERNEL_AVX2 2
+
+#define COLUMN_KERNEL_BATCH 8
+#define COLUMN_KERNEL_ALIGNMENT 32
+
+// Buffers of one row, padded to whole batches and aligned for vector loads.
+// Index column - 1 holds the pixel of column.
+struct Column_Kernel_Row {
+  int width;
+  int *east;
+  int *north;
+  unsigned char *match;
+  std::vector<int> positionStorage;
+  std::vector<unsigned char> matchStorage;
+};
+
+void allocateColumnKernelRow(Column_Kernel_Row &row, int frameWidth);
+
+int columnKernelLevel();
+const char *columnKernelName();
+
+void computeRowPositions(double longitudeLeftPoint, double latitudeLeftPoint, double steppingWidthEast, double steppingWidthNorth, Column_Kernel_Row &row);
+void matchRowPositions(const Plan_Index &index, Column_Kernel_Row &row);
+
+
+/*************************************/
+/*** Fixed point stepping of a row ***/
+/*************************************/
+// Positions as 32.32 fixed point micro-degrees, starting at the left point
+// and adding a constant step per column, no floating point in the loop.
+// Results are converted with the same truncation towards zero as the long
+// double reference and are identical to it, except where the reference
+// position lies within frameWidth * 2^-32 micro-degrees of an integer, the
+// accumulated rounding error of the step. Positions must stay within
+// +-2^31 micro-degrees, which covers all valid coordinates.
+#define FIXED_POINT_FRACTION_BITS 32
+
+void computeRowPositionsFixedPoint(long double longitudeLeftPoint, long double latitudeLeftPoint, long double steppingWidthEast, long double steppingWidthNorth, Column_Kernel_Row &row);
+
+#endif /* COLUMN_KERNEL_HPP */
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <stdlib.h>
+#include <atomic>
+
+#include <opencv2/core.hpp>
+
+#include "frame_overlay.hpp"
+#include "stage_timing.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Time of one frame per stage in ns, summed over the rows
+struct Overlay_Timing {
+  int64_t projection;
+  int64_t matching;
+  int64_t drawing;
+};
+
+
+void initOverlayWorker(Overlay_Worker &worker, const Overlay_Context &context)
+{
+  allocateColumnKernelRow(worker.columnKernelRow, context.cameraGeometry.frameWidth);
+  worker.tiltedGeometry.rowCount = -1;
+  worker.tiltedGeometryTilt = context.tilt;
+  if(context.settings.mask)
+    worker.mask.create(context.cameraGeometry.frameHeight, context.cameraGeometry.frameWidth, CV_8UC1);
+}
+
+
+/****************************************/
+/*** Solution 1, purely trigonometric ***/
+/****************************************/
+static void overlaySolution1(const Camera_Geometry<Projection_Real> &cameraGeometry, const Projection_Pose<Projection_Real> &projectionPose)
+{
+  #if CSV_OUTPUT
+    int pixelPositionEast;
+    int pixelPositionNorth;
+    cout << "row;column;pixelPositionEast;pixelPositionNorth;" << endl;
+  #endif
+
+  for (int row = 1; row <= cameraGeometry.rowCount; row++)  // Rows above are irrelevant
+  {
+    for (int column = 1; column <= cameraGeometry.frameWidth; column++)
+    {
+      Projection_Real positionEast;
+      Projection_Real positionNorth;
+      projectPixelSolution1(cameraGeometry, projectionPose, row, column, positionEast, positionNorth);
+
+      #if BASH_OUTPUT
+        cout << "Tangent: " << cameraGeometry.sidelineTangent[column - 1] << ";positionEast: " << positionEast << ";positionNorth: " << positionNorth << endl;
+        if (column > 100)
+          exit(0);
+      #endif
+
+      #if CSV_OUTPUT
+        pixelPositionEast = positionEast;
+        pixelPositionNorth = positionNorth;
+        cout << row << ";" << column<< ";" << pixelPositionEast << ";" << pixelPositionNorth << ";" << endl;
+      #endif
+    }
+  }
+}
+
+
+/******************************************************/
+/*** Solution 2, triginometric and linear equations ***/
+/******************************************************/
+// timing is NULL if stage timing is off, mask is NULL without mask output
+static void overlaySolution2Row(Mat &frame, const Overlay_Context &context, const Camera_Geometry<Projection_Real> &cameraGeometry, const Projection_Pose<Projection_Real> &projectionPose, int row, Column_Kernel_Row &columnKernelRow, Overlay_Timing *timing, Mat *mask)
+{
+  const Overlay_Settings &settings = context.settings;
+  int frameHeight = cameraGeometry.frameHeight;
+  int frameWidth = cameraGeometry.frameWidth;
+  int pixelPositionEast;
+  int pixelPositionNorth;
+  uchar *maskRow = mask ? mask->ptr<uchar>(frameHeight - row) : NULL;
+
+  int64_t rowBegin = timing ? stageClock() : 0;
+  Solution_2_Row<Projection_Real> rowProjection;
+  projectRowSolution2(cameraGeometry, projectionPose, row, rowProjection);
+  Projection_Real longitudeLeftPoint = rowProjection.longitudeLeftPoint;
+  Projection_Real latitudeLeftPoint = rowProjection.latitudeLeftPoint;
+  Projection_Real steppingWidthEast = rowProjection.steppingWidthEast;
+  Projection_Real steppingWidthNorth = rowProjection.steppingWidthNorth;
+
+  #if BASH_OUTPUT
+    cout << "longitude: " << projectionPose.longitude << endl;
+    cout << "latitude:  " << projectionPose.latitude << endl;
+    cout << "distanceOfBaseline:  " << cameraGeometry.distanceOfBaseline[row - 1] << endl;
+    cout << "distanceOfSideline:  " << cameraGeometry.distanceOfSideline[row - 1] << endl;
+    cout << "Longitude L/R: " <<  rowProjection.longitudeLeftPoint << " / " << rowProjection.longitudeRightPoint << endl;
+    cout << "Latitude  L/R: " << rowProjection.latitudeLeftPoint << " / " << rowProjection.latitudeRightPoint << endl;
+    cout << "*******" << endl;
+    cout << "steppingWidthEast:  " << steppingWidthEast << endl;
+    cout << "steppingWidthNorth: " << steppingWidthNorth << endl << endl;
+    if (row > 10)
+      exit(0);
+  #endif
+
+  // Positions of all columns first, then their lookup, then the drawing
+  int64_t rowProjected;
+  int64_t rowMatched;
+  if(settings.columnKernel != OVERLAY_KERNEL_NONE)
+  {
+    if(settings.columnKernel == OVERLAY_KERNEL_FIXED_POINT)
+      computeRowPositionsFixedPoint(longitudeLeftPoint, latitudeLeftPoint, steppingWidthEast, steppingWidthNorth, columnKernelRow);
+    else
+      computeRowPositions(longitudeLeftPoint, latitudeLeftPoint, steppingWidthEast, steppingWidthNorth, columnKernelRow);
+    rowProjected = timing ? stageClock() : 0;
+    matchRowPositions(*context.planIndex, columnKernelRow);
+    rowMatched = timing ? stageClock() : 0;
+  }
+  else
+  {
+    for (int column = 1; column <= frameWidth; column++)
+    {
+      pixelPositionEast = (int)(columnPositionSolution2(longitudeLeftPoint, steppingWidthEast, column) * 1000000);
+      pixelPositionNorth = (int)(columnPositionSolution2(latitudeLeftPoint, steppingWidthNorth, column) * 1000000);
+      #if BASH_OUTPUT
+        cout << "East: " << pixelPositionEast << "\tNorth: " << pixelPositionNorth <<  endl;
+        if (column > 10)
+          exit(0);
+      #endif
+      #if CSV_OUTPUT
+        cout << row << ";" << column<< ";" << cameraGeometry.distanceOfBaseline[row - 1] << ";" << pixelPositionEast << ";" << pixelPositionNorth << endl;
+      #endif
+      columnKernelRow.east[column - 1] = pixelPositionEast;
+      columnKernelRow.north[column - 1] = pixelPositionNorth;
+    }
+    rowProjected = timing ? stageClock() : 0;
+
+    /*** Compare image position ***/
+    for (int column = 1; column <= frameWidth; column++)
+    {
+      pixelPositionEast = columnKernelRow.east[column - 1];
+      pixelPositionNorth = columnKernelRow.north[column - 1];
+      bool match;
+      if(settings.planLookup == OVERLAY_LOOKUP_INDEX)
+        match = planIndexContains(*context.planIndex, pixelPositionEast, pixelPositionNorth);
+      else
+        match = comparePositionToLineMark(pixelPositionEast, pixelPositionNorth, context.lineMark, context.markingSize);
+      #if DEBUG_LOOKUP_COMPARE
+        if(match != comparePositionToLineMark(pixelPositionEast, pixelPositionNorth, context.lineMark, context.markingSize))
+          cout << "Lookup mismatch at " << column << " / " << row << ": " << pixelPositionNorth << "; " << pixelPositionEast << endl;
+      #endif
+      #if DEBUG_MARKING_CSV
+        cout << column << ";" << row << ";" << pixelPositionNorth << ";" << pixelPositionEast << endl;
+      #endif
+      columnKernelRow.match[column - 1] = match;
+    }
+    rowMatched = timing ? stageClock() : 0;
+  }
+
+  // Columns 1 to frameWidth are positioned, the last one lies right of the image
+  for (int column = 1; column < frameWidth; column++)
+  {
+    if(columnKernelRow.match[column - 1])
+    {
+      frame.at<Vec3b>(frameHeight - row, column) = Vec3b(0, 0, 255);
+      if(maskRow)
+        maskRow[column] = 1;
+    }
+  }
+  if(timing)
+  {
+    timing->projection += rowProjected - rowBegin;
+    timing->matching += rowMatched - rowProjected;
+    timing->drawing += stageClock() - rowMatched;
+  }
+}
+
+
+static void overlaySolution2(Mat &frame, const Overlay_Context &context, const Camera_Geometry<Projection_Real> &cameraGeometry, const Projection_Pose<Projection_Real> &projectionPose, Overlay_Worker &worker, Overlay_Timing *timing, int frameIndex)
+{
+  int rowThreads = context.settings.rowThreads;
+  Mat *mask = context.settings.mask ? &worker.mask : NULL;
+
+  #if CSV_OUTPUT
+    cout << "row;column;distanceOfBaseline;pixelPositionEast;pixelPositionNorth" << endl;
+  #endif
+
+  // The debug outputs are row by row, keep them in order
+  #if CSV_OUTPUT | BASH_OUTPUT | DEBUG_MARKING_CSV | DEBUG_LOOKUP_COMPARE
+    rowThreads = 1;
+  #endif
+
+  if(rowThreads == 1 || cameraGeometry.rowCount < 2)
+  {
+    for (int row = 1; row <= cameraGeometry.rowCount; row++)  // Rows above are irrelevant
+      overlaySolution2Row(frame, context, cameraGeometry, projectionPose, row, worker.columnKernelRow, timing, mask);
+    return;
+  }
+
+  // Row r draws only into image row frameHeight - r, columns 1 to
+  // frameWidth - 1, and the same row of the mask, so the stripes need no locking.
+  // Each stripe gets its own row buffer and its own timing, which is added
+  // to the frame once the stripe is done.
+  double stripes = (rowThreads > 1) ? rowThreads : getNumThreads();
+  atomic<int64_t> stripeTiming[3] = {{0}, {0}, {0}};
+  parallel_for_(Range(1, cameraGeometry.rowCount + 1), [&](const Range &range)
+  {
+    Column_Kernel_Row columnKernelRow;
+    allocateColumnKernelRow(columnKernelRow, cameraGeometry.frameWidth);
+    Overlay_Timing rowTiming = {0, 0, 0};
+    int64_t stripeBegin = stageTimingBegin();
+    for (int row = range.start; row < range.end; row++)
+      overlaySolution2Row(frame, context, cameraGeometry, projectionPose, row, columnKernelRow, timing ? &rowTiming : NULL, mask);
+    if(timing)
+    {
+      if(frameTraceEnabled())
+      {
+        setTraceThreadName("row stripe");  // OpenCV pool threads, the calling overlay thread keeps its name
+        traceFrameEventWithRows("solution2 stripe", frameIndex, stripeBegin, stageClock(), rowTiming.projection, rowTiming.matching, rowTiming.drawing);
+      }
+      stripeTiming[0] += rowTiming.projection;
+      stripeTiming[1] += rowTiming.matching;
+      stripeTiming[2] += rowTiming.drawing;
+    }
+  }, stripes);
+  if(timing)
+  {
+    timing->projection += stripeTiming[0];
+    timing->matching += stripeTiming[1];
+    timing->drawing += stripeTiming[2];
+  }
+}
+
+
+// Tilts that come with the pose need their own geometry, it is kept per
+// worker until the tilt changes
+static const Camera_Geometry<Projection_Real> &geometryForTilt(const Overlay_Context &context, double tilt, Overlay_Worker &worker)
+{
+  if(tilt == context.tilt)
+    return context.cameraGeometry;
+  if(worker.tiltedGeometry.rowCount < 0 || worker.tiltedGeometryTilt != tilt)
+  {
+    buildCameraGeometry(worker.tiltedGeometry, tilt, context.cameraGeometry.frameWidth, context.cameraGeometry.frameHeight);
+    worker.tiltedGeometryTilt = tilt;
+  }
+  return worker.tiltedGeometry;
+}
+
+
+void overlayFrame(Mat &frame, const Overlay_Context &context, const Camera_Pose &pose, Overlay_Worker &worker, int frameIndex)
+{
+  const Overlay_Settings &settings = context.settings;
+  Overlay_Timing frameTiming = {0, 0, 0};
+  Overlay_Timing *timing = (stageTimingEnabled() || frameTraceEnabled()) ? &frameTiming : NULL;
+  int64_t begin = stageTimingBegin();
+
+  const Camera_Geometry<Projection_Real> &cameraGeometry = geometryForTilt(context, pose.tilt, worker);
+  if(settings.mask)
+    worker.mask.setTo(0);
+
+  Projection_Pose<Projection_Real> projectionPose;
+  buildProjectionPose(projectionPose, pose.latitude, pose.longitude, pose.direction);
+
+  if(settings.solution1)
+    overlaySolution1(cameraGeometry, projectionPose);
+  int64_t end = stageTimingBegin();
+  if(timing)
+  {
+    frameTiming.projection += end - begin;
+    if(settings.solution1 && frameTraceEnabled())
+      traceFrameEvent("solution1", frameIndex, begin, end);
+  }
+
+  if(settings.solution2)
+  {
+    begin = end;
+    Overlay_Timing rowTiming = {0, 0, 0};
+    overlaySolution2(frame, context, cameraGeometry, projectionPose, worker, timing ? &rowTiming : NULL, frameIndex);
+    end = stageTimingBegin();
+    if(timing)
+    {
+      frameTiming.projection += rowTiming.projection;
+      frameTiming.matching += rowTiming.matching;
+      frameTiming.drawing += rowTiming.drawing;
+      if(frameTraceEnabled())
+        traceFrameEventWithRows("solution2", frameIndex, begin, end, rowTiming.projection, rowTiming.matching, rowTiming.drawing);
+    }
+  }
+
+  // Solution 3 and 4 project and draw in one go, they count as drawing
+  begin = end;
+
+  /*** Solution 3, forward projection of plan segments ***/
+  if(settings.solution3)
+    drawPlanForwardProjected(frame, context.gpsPoint, context.dataCounter, pose);
+
+  /*** Solution 4, homography of the ground to the image ***/
+  if(settings.solution4)
+    drawPlanHomography(frame, context.gpsPoint, context.dataCounter, pose, cameraGeometry.rowCount);
+
+  if(timing)
+  {
+    end = stageClock();
+    frameTiming.drawing += end - begin;
+    if((settings.solution3 || settings.solution4) && frameTraceEnabled())
+      traceFrameEvent(settings.solution3 ? "solution3" : "solution4", frameIndex, begin, end);
+    if(stageTimingEnabled())
+    {
+      recordStageTime(TIMING_STAGE_PROJECTION, frameTiming.projection);
+      recordStageTime(TIMING_STAGE_MATCHING, frameTiming.matching);
+      recordStageTime(TIMING_STAGE_DRAWING, frameTiming.drawing);
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef FRAME_OVERLAY_HPP
+#define FRAME_OVERLAY_HPP
+
+#include <opencv2/core.hpp>
+
+#include "plan_types.hpp"
+#include "plan_index.hpp"
+#include "camera_projection.hpp"
+#include "projection_math.hpp"
+#include "column_kernel.hpp"
+
+// DEBUGGING
+#define CSV_OUTPUT 0
+#define BASH_OUTPUT 0
+#define DEBUG_LOOKUP_COMPARE 0
+#define DEBUG_MARKING_CSV 0
+
+#define OVERLAY_LOOKUP_REFERENCE 0  // comparePositionToLineMark
+#define OVERLAY_LOOKUP_INDEX 1  // Plan_Index, bitmap or hash set
+
+#define OVERLAY_KERNEL_NONE 0 // Pixel by pixel in Projection_Real
+#define OVERLAY_KERNEL_SIMD 1
+#define OVERLAY_KERNEL_FIXED_POINT 2
+
+struct Overlay_Settings {
+  bool solution1;
+  bool solution2;
+  bool solution3;
+  bool solution4;
+  int planLookup;
+  int columnKernel;
+  int rowThreads; // SOLUTION_2 rows split over cv::parallel_for_, 1 = serial, 0 = OpenCV default
+  bool mask;  // Also mark the SOLUTION_2 matches in Overlay_Worker::mask
+};
+
+// Read only state shared by all frames and threads
+struct Overlay_Context {
+  Overlay_Settings settings;
+  const GPS_Point *gpsPoint;
+  int dataCounter;
+  const Line_Marking_Points *lineMark;
+  size_t markingSize;
+  const Plan_Index *planIndex;
+  Camera_Geometry<Projection_Real> cameraGeometry;
+  double tilt;
+};
+
+// Scratch memory of one overlay thread
+struct Overlay_Worker {
+  Column_Kernel_Row columnKernelRow;
+  Camera_Geometry<Projection_Real> tiltedGeometry;  // For poses with an own tilt, rowCount -1 until first used
+  double tiltedGeometryTilt;
+  cv::Mat mask; // CV_8UC1 of the frame size, 1 on the pixels matched in the last frame, empty without settings.mask
+};
+
+void initOverlayWorker(Overlay_Worker &worker, const Overlay_Context &context);
+
+// Draws the plan into one frame seen from the given camera pose, the frame
+// index only labels the stage timing and trace events
+void overlayFrame(cv::Mat &frame, const Overlay_Context &context, const Camera_Pose &pose, Overlay_Worker &worker, int frameIndex);
+
+#endif /* FRAME_OVERLAY_HPP */
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <map>
+#include <thread>
+
+#include "frame_pipeline.hpp"
+#include "frame_trace.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Empty items are swapped into the rings, they start initialized
+struct Pipeline_Frame {
+  Mat frame;
+  int frameIndex = -1;
+  double timestamp = 0;
+};
+
+
+void pipelineBackoff(int &idleCounter)
+{
+  if(idleCounter++ < 64)
+    this_thread::yield();
+  else
+    this_thread::sleep_for(chrono::microseconds(200));
+}
+
+
+int defaultPipelineWorkers()
+{
+  int cores = thread::hardware_concurrency();
+  return max(1, cores - 2);
+}
+
+
+static void runFramePipelineSerial(const Decode_Stage &decode, const Overlay_Stage &overlay, const Sink_Stage &sink)
+{
+  Mat frame;
+  double timestamp;
+  setTraceThreadName("pipeline");
+  for(int frameIndex = 0; decode(frame, timestamp); frameIndex++)
+  {
+    overlay(frame, frameIndex, timestamp, 0);
+    if(!sink(frame, frameIndex, timestamp))
+      break;
+  }
+}
+
+
+void runFramePipeline(const Frame_Pipeline_Settings &settings, const Decode_Stage &decode, const Overlay_Stage &overlay, const Sink_Stage &sink)
+{
+  if(settings.workerCount <= 0)
+  {
+    runFramePipelineSerial(decode, overlay, sink);
+    return;
+  }
+
+  // Both queues can hold every frame in flight, so a push only waits for a
+  // slow consumer, never for the stage behind it
+  int maxInFlight = max(settings.queueCapacity, settings.workerCount);
+  Bounded_Ring<Pipeline_Frame> decodedFrames(maxInFlight);
+  Bounded_Ring<Pipeline_Frame> overlaidFrames(maxInFlight);
+  atomic<bool> stop(false);
+  atomic<bool> decodeFinished(false);
+  atomic<int> framesDecoded(0);
+  atomic<int> framesSunk(0);
+
+  /*** Decode thread ***/
+  thread decodeThread([&]()
+  {
+    setTraceThreadName("decode");
+    for(int frameIndex = 0; !stop.load(); frameIndex++)
+    {
+      int idleCounter = 0;
+      while(((frameIndex - framesSunk.load()) >= maxInFlight) && !stop.load())
+        pipelineBackoff(idleCounter);
+
+      Pipeline_Frame item;
+      item.frameIndex = frameIndex;
+      if(stop.load() || !decode(item.frame, item.timestamp))
+        break;
+      idleCounter = 0;
+      while(!decodedFrames.tryPush(item) && !stop.load())
+        pipelineBackoff(idleCounter);
+      framesDecoded.store(frameIndex + 1);
+    }
+    decodeFinished.store(true);
+  });
+
+  /*** Overlay threads ***/
+  vector<thread> workerThreads;
+  for(int workerIndex = 0; workerIndex < settings.workerCount; workerIndex++)
+  {
+    workerThreads.push_back(thread([&, workerIndex]()
+    {
+      setTraceThreadName("overlay " + to_string(workerIndex));
+      int idleCounter = 0;
+      while(!stop.load())
+      {
+        bool finished = decodeFinished.load();  // read before the pop, a later frame can not appear any more
+        Pipeline_Frame item;
+        if(!decodedFrames.tryPop(item))
+        {
+          if(finished)
+            break;
+          pipelineBackoff(idleCounter);
+          continue;
+        }
+        idleCounter = 0;
+        overlay(item.frame, item.frameIndex, item.timestamp, workerIndex);
+        while(!overlaidFrames.tryPush(item) && !stop.load())
+          pipelineBackoff(idleCounter);
+      }
+    }));
+  }
+
+  /*** Ordered sink on the calling thread ***/
+  setTraceThreadName("sink");
+  map<int, Pipeline_Frame> reorderBuffer;
+  int nextFrameIndex = 0;
+  int idleCounter = 0;
+  while(!stop.load())
+  {
+    bool finished = decodeFinished.load();
+    Pipeline_Frame item;
+    while(overlaidFrames.tryPop(item))
+    {
+      swap(reorderBuffer[item.frameIndex], item);
+      idleCounter = 0;
+    }
+
+    map<int, Pipeline_Frame>::iterator next;
+    while(!stop.load() && ((next = reorderBuffer.find(nextFrameIndex)) != reorderBuffer.end()))
+    {
+      if(!sink(next->second.frame, nextFrameIndex, next->second.timestamp))
+        stop.store(true);
+      reorderBuffer.erase(next);
+      framesSunk.store(++nextFrameIndex);
+    }
+
+    if(finished && (nextFrameIndex >= framesDecoded.load()))
+      break;
+    pipelineBackoff(idleCounter);
+  }
+
+  stop.store(true);
+  decodeThread.join();
+  for(size_t workerIndex = 0; workerIndex < workerThreads.size(); workerIndex++)
+    workerThreads[workerIndex].join();
+}
@@ -0,0 +1,127 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/******************************/
+/*** Bounded lock free ring ***/
+/******************************/
+// Multi producer / multi consumer queue after D. Vyukov. Every cell carries a
+// sequence number that tells producers and consumers whose turn it is, so
+// push and pop only need one compare-and-swap on the shared position.
+template<typename T>
+class Bounded_Ring {
+public:
+  explicit Bounded_Ring(size_t capacity)
+  {
+    size_t cellCount = 2;
+    while(cellCount < capacity)
+      cellCount <<= 1;
+    cells = std::vector<Cell>(cellCount); // Cells never move after this
+    for(size_t cellCounter = 0; cellCounter < cellCount; cellCounter++)
+      cells[cellCounter].sequence.store(cellCounter, std::memory_order_relaxed);
+    cellMask = cellCount - 1;
+    enqueuePosition.store(0, std::memory_order_relaxed);
+    dequeuePosition.store(0, std::memory_order_relaxed);
+  }
+
+  bool tryPush(T &item)
+  {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      Cell &cell = cells[position & cellMask];
+      intptr_t difference = (intptr_t) cell.sequence.load(std::memory_order_acquire) - (intptr_t) position;
+      if(difference == 0)
+      {
+        if(enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          std::swap(cell.item, item);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(difference < 0)
+        return false;   // full
+      else
+        position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool tryPop(T &item)
+  {
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    for(;;)
+    {
+      Cell &cell = cells[position & cellMask];
+      intptr_t difference = (intptr_t) cell.sequence.load(std::memory_order_acquire) - (intptr_t) (position + 1);
+      if(difference == 0)
+      {
+        if(dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          std::swap(item, cell.item);
+          cell.sequence.store(position + cellMask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if(difference < 0)
+        return false;   // empty
+      else
+        position = dequeuePosition.load(std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const
+  {
+    return cellMask + 1;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  std::vector<Cell> cells;
+  size_t cellMask;
+  alignas(64) std::atomic<size_t> enqueuePosition;
+  alignas(64) std::atomic<size_t> dequeuePosition;
+};
+
+
+// Spins briefly, then sleeps, so idle stages do not burn a core
+void pipelineBackoff(int &idleCounter);
+
+
+/**********************/
+/*** Frame pipeline ***/
+/**********************/
+// One decode thread, workerCount overlay threads and the calling thread as
+// the sink, connected by two Bounded_Ring queues. The sink gets the frames in
+// decode order, a reorder buffer holds frames that finished early. At most
+// queueCapacity frames are in flight, which bounds the memory use.
+// HighGUI calls must stay on the thread that created the window, so display
+// belongs into the sink.
+//
+// workerCount 0 runs all stages one after another on the calling thread.
+// The decode stage also gives the timestamp of the frame in ms, which then
+// travels with the frame.
+typedef std::function<bool (cv::Mat &frame, double &timestamp)> Decode_Stage;  // false at the end of the video
+typedef std::function<void (cv::Mat &frame, int frameIndex, double timestamp, int workerIndex)> Overlay_Stage;
+typedef std::function<bool (cv::Mat &frame, int frameIndex, double timestamp)> Sink_Stage;  // false stops the pipeline
+
+struct Frame_Pipeline_Settings {
+  int workerCount;
+  int queueCapacity;
+};
+
+// One overlay thread per core, minus the decode and the sink thread
+int defaultPipelineWorkers();
+
+void runFramePipeline(const Frame_Pipeline_Settings &settings, const Decode_Stage &decode, const Overlay_Stage &overlay, const Sink_Stage &sink);
+
+#endif /* FRAME_PIPELINE_HPP */
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame_trace.hpp"
+#include "frame_pipeline.hpp"
+#include "stage_timing.hpp"
+
+using namespace std;
+
+atomic<bool> frameTraceOn(false);
+
+// Ring of one producing thread, the writer thread is the only consumer
+struct Trace_Thread {
+  Bounded_Ring<Trace_Event> ring;
+  int threadId;
+  string name;  // Guarded by traceMutex, written as thread_name metadata at the end
+  atomic<uint64_t> dropped;
+
+  Trace_Thread(int id, const string &threadName) : ring(TRACE_RING_EVENTS), threadId(id), name(threadName), dropped(0) {}
+};
+
+static mutex traceMutex;
+static vector<unique_ptr<Trace_Thread> > traceThreads;
+static thread_local Trace_Thread *threadTrace = NULL;
+static thread_local string threadName;  // Kept without a trace too, the trace may start later
+
+static FILE *traceFile = NULL;
+static thread traceWriter;
+static atomic<bool> traceStopping(false);
+static int64_t traceStart = 0;
+static uint64_t eventsWritten = 0;
+
+
+static Trace_Thread *registerTraceThread()
+{
+  lock_guard<mutex> lock(traceMutex);
+  int threadId = traceThreads.size() + 1;
+  traceThreads.push_back(unique_ptr<Trace_Thread>(new Trace_Thread(threadId, threadName.empty() ? "thread " + to_string(threadId) : threadName)));
+  return traceThreads.back().get();
+}
+
+
+void setTraceThreadName(const string &name)
+{
+  if(!threadName.empty())
+    return;
+  threadName = name;
+  if(threadTrace)
+  {
+    lock_guard<mutex> lock(traceMutex);
+    threadTrace->name = name;
+  }
+}
+
+
+static void pushTraceEvent(Trace_Event &event)
+{
+  Trace_Thread *trace = threadTrace;
+  if(trace == NULL)
+    trace = threadTrace = registerTraceThread();
+  if(!trace->ring.tryPush(event))
+    trace->dropped.store(trace->dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+
+void traceFrameEvent(const char *name, int frameIndex, int64_t begin, int64_t end)
+{
+  Trace_Event event = {name, frameIndex, begin, end, -1, -1, -1};
+  pushTraceEvent(event);
+}
+
+
+void traceFrameEventWithRows(const char *name, int frameIndex, int64_t begin, int64_t end, int64_t projection, int64_t matching, int64_t drawing)
+{
+  Trace_Event event = {name, frameIndex, begin, end, projection, matching, drawing};
+  pushTraceEvent(event);
+}
+
+
+static void writeTraceEvent(const Trace_Event &event, int threadId)
+{
+  fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", event.name, threadId, (event.begin - traceStart) / 1e3, (event.end - event.begin) / 1e3);
+  if(event.frameIndex >= 0 || event.projection >= 0)
+  {
+    fprintf(traceFile, ",\"args\":{");
+    if(event.frameIndex >= 0)
+      fprintf(traceFile, "\"frame\":%d%s", event.frameIndex, (event.projection >= 0) ? "," : "");
+    if(event.projection >= 0)
+      fprintf(traceFile, "\"projection_ms\":%.3f,\"matching_ms\":%.3f,\"drawing_ms\":%.3f", event.projection / 1e6, event.matching / 1e6, event.drawing / 1e6);
+    fprintf(traceFile, "}");
+  }
+  fprintf(traceFile, "}");
+  eventsWritten++;
+}
+
+
+static void drainTraceRings()
+{
+  vector<Trace_Thread *> threads;
+  {
+    lock_guard<mutex> lock(traceMutex);
+    for(size_t threadCounter = 0; threadCounter < traceThreads.size(); threadCounter++)
+      threads.push_back(traceThreads[threadCounter].get());
+  }
+
+  Trace_Event event = {NULL, -1, 0, 0, -1, -1, -1}; // Swapped into the ring cell, so it starts initialized
+  for(size_t threadCounter = 0; threadCounter < threads.size(); threadCounter++)
+  {
+    while(threads[threadCounter]->ring.tryPop(event))
+      writeTraceEvent(event, threads[threadCounter]->threadId);
+  }
+}
+
+
+static void traceWriterLoop()
+{
+  while(!traceStopping.load())
+  {
+    drainTraceRings();
+    this_thread::sleep_for(chrono::milliseconds(TRACE_WRITER_INTERVAL_MS));
+  }
+  drainTraceRings();
+}
+
+
+bool startFrameTrace(const string &fileName)
+{
+  traceFile = fopen(fileName.c_str(), "w");
+  if(traceFile == NULL)
+  {
+    cout << "Could not write trace " << fileName << endl;
+    return false;
+  }
+  setvbuf(traceFile, NULL, _IOFBF, 1 << 20);
+
+  traceStart = stageClock();
+  eventsWritten = 0;
+  fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(traceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"read_video_to_images\"}}");
+  traceStopping.store(false);
+  traceWriter = thread(traceWriterLoop);
+  frameTraceOn.store(true);
+  return true;
+}
+
+
+void stopFrameTrace()
+{
+  if(traceFile == NULL)
+    return;
+  frameTraceOn.store(false);
+  traceStopping.store(true);
+  traceWriter.join();
+
+  // Metadata may stand anywhere in the array, at the end every thread has its final name
+  uint64_t dropped = 0;
+  lock_guard<mutex> lock(traceMutex);
+  for(size_t threadCounter = 0; threadCounter < traceThreads.size(); threadCounter++)
+  {
+    const Trace_Thread &trace = *traceThreads[threadCounter];
+    fprintf(traceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", trace.threadId, trace.name.c_str());
+    dropped += trace.dropped.load();
+  }
+  fprintf(traceFile, "\n]}\n");
+  fclose(traceFile);
+  traceFile = NULL;
+  cout << "Trace: " << eventsWritten << " events, " << dropped << " dropped" << endl;
+}
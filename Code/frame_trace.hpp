@@ -0,0 +1,52 @@
+#ifndef FRAME_TRACE_HPP
+#define FRAME_TRACE_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#define TRACE_RING_EVENTS 8192  // Events per thread waiting for the writer, more are dropped
+#define TRACE_WRITER_INTERVAL_MS 20
+
+// Complete event of one section, times in ns of stageClock()
+struct Trace_Event {
+  const char *name; // String literal, only the pointer is kept
+  int frameIndex; // -1 = not bound to a frame
+  int64_t begin;
+  int64_t end;
+  int64_t projection; // Row times of SOLUTION_2 in ns, -1 = none
+  int64_t matching;
+  int64_t drawing;
+};
+
+
+/*******************/
+/*** Frame trace ***/
+/*******************/
+// Chrome trace / Perfetto JSON of the frame loop. Every thread puts its
+// events into its own ring, a background thread drains the rings and writes
+// the file. A full ring drops the event instead of waiting.
+extern std::atomic<bool> frameTraceOn;
+
+inline bool frameTraceEnabled()
+{
+  return frameTraceOn.load(std::memory_order_relaxed);
+}
+
+// False if the file can not be written
+bool startFrameTrace(const std::string &fileName);
+
+// Writes the remaining events and closes the file, call once the threads are done
+void stopFrameTrace();
+
+// Name of the calling thread in the trace viewer, e.g. "decode" or "overlay 2".
+// The first name of a thread sticks, so pool threads can be named by
+// whatever runs on them first without renaming the pipeline threads.
+void setTraceThreadName(const std::string &name);
+
+void traceFrameEvent(const char *name, int frameIndex, int64_t begin, int64_t end);
+
+// Event with the projection, matching and drawing time of the rows as arguments
+void traceFrameEventWithRows(const char *name, int frameIndex, int64_t begin, int64_t end, int64_t projection, int64_t matching, int64_t drawing);
+
+#endif /* FRAME_TRACE_HPP */
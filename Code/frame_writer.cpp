@@ -0,0 +1,109 @@
+#include <iostream>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "frame_writer.hpp"
+#include "stage_timing.hpp"
+
+using namespace std;
+using namespace cv;
+
+
+const char *frameFormatExtension(int format)
+{
+  if(format == FRAME_FORMAT_JPEG)
+    return ".jpg";
+  if(format == FRAME_FORMAT_PPM)
+    return ".ppm";
+  return ".png";
+}
+
+
+Frame_Writer::Frame_Writer(const Frame_Writer_Settings &writerSettings)
+  : settings(writerSettings), jobs(max(1, writerSettings.queueCapacity)), finishing(false), writtenCounter(0), droppedCounter(0), errorCounter(0)
+{
+  if(settings.format == FRAME_FORMAT_JPEG)
+  {
+    encodeParameters.push_back(IMWRITE_JPEG_QUALITY);
+    encodeParameters.push_back(settings.jpegQuality);
+  }
+  else if(settings.format == FRAME_FORMAT_PPM)
+  {
+    encodeParameters.push_back(IMWRITE_PXM_BINARY);
+    encodeParameters.push_back(1);
+  }
+  else
+  {
+    encodeParameters.push_back(IMWRITE_PNG_COMPRESSION);
+    encodeParameters.push_back(settings.pngCompression);
+  }
+
+  for(int threadCounter = 0; threadCounter < max(1, settings.threadCount); threadCounter++)
+    threads.push_back(thread(&Frame_Writer::encodeLoop, this));
+}
+
+
+Frame_Writer::~Frame_Writer()
+{
+  finish();
+}
+
+
+bool Frame_Writer::write(const Mat &frame, const string &fileName)
+{
+  Frame_Job job;
+  frame.copyTo(job.frame);
+  job.fileName = fileName;
+
+  int idleCounter = 0;
+  while(!jobs.tryPush(job))
+  {
+    if(settings.backpressure == FRAME_WRITER_DROP)
+    {
+      droppedCounter++;
+      return false;
+    }
+    pipelineBackoff(idleCounter);
+  }
+  return true;
+}
+
+
+void Frame_Writer::finish()
+{
+  finishing.store(true);
+  for(size_t threadCounter = 0; threadCounter < threads.size(); threadCounter++)
+    threads[threadCounter].join();
+  threads.clear();
+}
+
+
+void Frame_Writer::encodeLoop()
+{
+  setTraceThreadName("frame writer");
+  int idleCounter = 0;
+  for(;;)
+  {
+    bool finished = finishing.load(); // read before the pop, write() is done once this is set
+    Frame_Job job;
+    if(!jobs.tryPop(job))
+    {
+      if(finished)
+        return;
+      pipelineBackoff(idleCounter);
+      continue;
+    }
+    idleCounter = 0;
+    int64_t begin = stageTimingBegin();
+    bool written = imwrite(job.fileName, job.frame, encodeParameters);
+    stageTimingEnd(TIMING_STAGE_ENCODE, begin, -1);
+    if(written)
+      writtenCounter++;
+    else
+    {
+      errorCounter++;
+      cout << "Could not write frame " << job.fileName << endl;
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_WRITER_HPP
+#define FRAME_WRITER_HPP
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "frame_pipeline.hpp"
+
+#define FRAME_FORMAT_PNG 0
+#define FRAME_FORMAT_JPEG 1
+#define FRAME_FORMAT_PPM 2  // Binary PPM, no compression at all
+
+#define FRAME_WRITER_BLOCK 0  // A full queue stalls the caller, no frame is lost
+#define FRAME_WRITER_DROP 1 // A full queue drops the frame, the caller never waits
+
+struct Frame_Writer_Settings {
+  int format;
+  int pngCompression; // 0 - 9
+  int jpegQuality;  // 0 - 100
+  int threadCount;
+  int queueCapacity;
+  int backpressure;
+};
+
+const char *frameFormatExtension(int format);
+
+
+/***************************/
+/*** Asynchronous writer ***/
+/***************************/
+// Encodes and stores frames on its own threads. The frames wait in a
+// Bounded_Ring, the backpressure setting decides what happens when the
+// encoders fall behind.
+class Frame_Writer {
+public:
+  explicit Frame_Writer(const Frame_Writer_Settings &settings);
+  ~Frame_Writer();
+
+  // Copies the frame, the caller may reuse it right away. Returns false if the frame was dropped.
+  bool write(const cv::Mat &frame, const std::string &fileName);
+
+  // Waits until every queued frame is on disk and stops the threads
+  void finish();
+
+  int framesWritten() const { return writtenCounter.load(); }
+  int framesDropped() const { return droppedCounter.load(); }
+  int writeErrors() const { return errorCounter.load(); }
+
+private:
+  struct Frame_Job {
+    cv::Mat frame;
+    std::string fileName;
+  };
+
+  void encodeLoop();
+
+  Frame_Writer_Settings settings;
+  std::vector<int> encodeParameters;
+  Bounded_Ring<Frame_Job> jobs;
+  std::vector<std::thread> threads;
+  std::atomic<bool> finishing;
+  std::atomic<int> writtenCounter;
+  std::atomic<int> droppedCounter;
+  std::atomic<int> errorCounter;
+};
+
+#endif /* FRAME_WRITER_HPP */
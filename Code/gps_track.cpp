@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gps_track.hpp"
+
+using namespace std;
+
+#define NO_HEADING -1000  // Marks samples that need the computed bearing
+
+
+static bool hasExtension(const string &fileName, const char *extension)
+{
+  size_t extensionLength = char_traits<char>::length(extension);
+  if(fileName.size() < extensionLength)
+    return false;
+  for(size_t charCounter = 0; charCounter < extensionLength; charCounter++)
+  {
+    if(tolower(fileName[fileName.size() - extensionLength + charCounter]) != extension[charCounter])
+      return false;
+  }
+  return true;
+}
+
+
+// Days since 1970-01-01 of a proleptic gregorian date
+static long daysFromCivil(int year, int month, int day)
+{
+  year -= (month <= 2);
+  long era = (year >= 0 ? year : year - 399) / 400;
+  long yearOfEra = year - era * 400;
+  long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+
+// Plain seconds or ISO 8601 UTC, e.g. 2019-05-14T10:21:07.250Z
+static bool parseTrackTime(const string &text, double &time)
+{
+  int year, month, day, hour, minute;
+  double second;
+  if(sscanf(text.c_str(), "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) == 6)
+  {
+    time = daysFromCivil(year, month, day) * 86400.0 + hour * 3600 + minute * 60 + second;
+    return true;
+  }
+  char *end;
+  time = strtod(text.c_str(), &end);
+  return (end != text.c_str()) && (*end == '\0' || isspace(*end));
+}
+
+
+static bool parseNumber(const string &text, long double &value)
+{
+  char *end;
+  value = strtold(text.c_str(), &end);
+  return (end != text.c_str()) && (*end == '\0' || isspace(*end));
+}
+
+
+static void splitFields(const string &line, char separator, vector<string> &fields)
+{
+  fields.clear();
+  size_t start = 0;
+  for(;;)
+  {
+    size_t end = line.find(separator, start);
+    fields.push_back(line.substr(start, end - start));
+    if(end == string::npos)
+      return;
+    start = end + 1;
+  }
+}
+
+
+static void trackError(const string &fileName, int lineNumber, const string &message)
+{
+  cout << fileName << ":" << lineNumber << ": " << message << endl;
+}
+
+
+/*************************/
+/*** CSV track parsing ***/
+/*************************/
+static bool loadCsvTrack(const string &fileName, ifstream &trackFile, GPS_Track &track)
+{
+  string line;
+  vector<string> fields;
+  track.hasTilt = true;
+  for(int lineNumber = 1; getline(trackFile, line); lineNumber++)
+  {
+    if(!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if(line.empty() || line[0] == '#')
+      continue;
+    splitFields(line, (line.find(';') != string::npos) ? ';' : ',', fields);
+
+    Track_Sample sample;
+    long double heading = NO_HEADING;
+    long double tilt = 0;
+    if(!parseTrackTime(fields[0], sample.time))
+    {
+      if(track.samples.empty() && lineNumber == 1)
+        continue; // Header
+      trackError(fileName, lineNumber, "invalid time " + fields[0]);
+      return false;
+    }
+    if(fields.size() < 3 || !parseNumber(fields[1], sample.latitude) || !parseNumber(fields[2], sample.longitude))
+    {
+      trackError(fileName, lineNumber, "expected time;latitude;longitude;heading[;tilt]");
+      return false;
+    }
+    if(fields.size() > 3 && !fields[3].empty() && !parseNumber(fields[3], heading))
+    {
+      trackError(fileName, lineNumber, "invalid heading " + fields[3]);
+      return false;
+    }
+    if(fields.size() > 4 && !fields[4].empty())
+    {
+      if(!parseNumber(fields[4], tilt))
+      {
+        trackError(fileName, lineNumber, "invalid tilt " + fields[4]);
+        return false;
+      }
+    }
+    else
+      track.hasTilt = false;
+    sample.heading = heading;
+    sample.tilt = tilt;
+    track.samples.push_back(sample);
+  }
+  return true;
+}
+
+
+/*************************/
+/*** GPX track parsing ***/
+/*************************/
+// Only trkpt elements are read, with their lat and lon attributes and the
+// time and course children. No full XML parser, GPX files are flat enough.
+static bool gpxAttribute(const string &element, const char *name, long double &value)
+{
+  string key = string(name) + "=";
+  size_t pos = element.find(key);
+  while(pos != string::npos && !isspace(element[pos - 1]))
+    pos = element.find(key, pos + 1);
+  if(pos == string::npos || pos + key.size() >= element.size())
+    return false;
+  char quote = element[pos + key.size()];
+  size_t end = element.find(quote, pos + key.size() + 1);
+  if(end == string::npos)
+    return false;
+  return parseNumber(element.substr(pos + key.size() + 1, end - pos - key.size() - 1), value);
+}
+
+
+static bool gpxChild(const string &element, const char *name, string &value)
+{
+  string open = string("<") + name + ">";
+  string close = string("</") + name + ">";
+  size_t start = element.find(open);
+  if(start == string::npos)
+    return false;
+  start += open.size();
+  size_t end = element.find(close, start);
+  if(end == string::npos)
+    return false;
+  value = element.substr(start, end - start);
+  return true;
+}
+
+
+static bool loadGpxTrack(const string &fileName, ifstream &trackFile, GPS_Track &track)
+{
+  string content((istreambuf_iterator<char>(trackFile)), istreambuf_iterator<char>());
+  track.hasTilt = false;
+  // Lines are counted from the previous trkpt on, every search stops at its
+  // own element, so the whole file is scanned only a constant number of times
+  int lineNumber = 1;
+  size_t countedUpTo = 0;
+  for(size_t pos = content.find("<trkpt"); pos != string::npos; pos = content.find("<trkpt", pos + 1))
+  {
+    lineNumber += count(content.begin() + countedUpTo, content.begin() + pos, '\n');
+    countedUpTo = pos;
+    size_t tagEnd = content.find('>', pos);
+    if(tagEnd == string::npos)
+    {
+      trackError(fileName, lineNumber, "unterminated trkpt");
+      return false;
+    }
+    size_t end;
+    if(content[tagEnd - 1] == '/')
+      end = tagEnd;
+    else
+      end = content.find("</trkpt>", tagEnd);
+    if(end == string::npos)
+    {
+      trackError(fileName, lineNumber, "trkpt without </trkpt>");
+      return false;
+    }
+    string element = content.substr(pos, end - pos);
+
+    Track_Sample sample;
+    string value;
+    long double heading = NO_HEADING;
+    if(!gpxAttribute(element, "lat", sample.latitude) || !gpxAttribute(element, "lon", sample.longitude))
+    {
+      trackError(fileName, lineNumber, "trkpt without lat and lon");
+      return false;
+    }
+    if(!gpxChild(element, "time", value) || !parseTrackTime(value, sample.time))
+    {
+      trackError(fileName, lineNumber, "trkpt without a valid time");
+      return false;
+    }
+    if((gpxChild(element, "course", value) || gpxChild(element, "heading", value)) && !parseNumber(value, heading))
+    {
+      trackError(fileName, lineNumber, "invalid course " + value);
+      return false;
+    }
+    sample.heading = heading;
+    sample.tilt = 0;
+    track.samples.push_back(sample);
+  }
+  return true;
+}
+
+
+/**************************/
+/*** NMEA track parsing ***/
+/**************************/
+// RMC sentences carry time, date, position and course over ground
+static bool nmeaCoordinate(const string &value, const string &hemisphere, int degreeDigits, long double &coordinate)
+{
+  long double minutes;
+  if(value.size() <= (size_t) degreeDigits || !parseNumber(value.substr(degreeDigits), minutes))
+    return false;
+  coordinate = atoi(value.substr(0, degreeDigits).c_str()) + minutes / 60;
+  if(hemisphere == "S" || hemisphere == "W")
+    coordinate = -coordinate;
+  return true;
+}
+
+
+static bool loadNmeaTrack(const string &fileName, ifstream &trackFile, GPS_Track &track)
+{
+  string line;
+  vector<string> fields;
+  track.hasTilt = false;
+  for(int lineNumber = 1; getline(trackFile, line); lineNumber++)
+  {
+    size_t checksum = line.find('*');
+    if(checksum != string::npos)
+      line.erase(checksum);
+    if(line.size() < 6 || line[0] != '$' || line.compare(3, 3, "RMC") != 0)
+      continue;
+    splitFields(line, ',', fields);
+    if(fields.size() < 10)
+    {
+      trackError(fileName, lineNumber, "RMC sentence with too few fields");
+      return false;
+    }
+    if(fields[2] != "A")
+      continue; // No fix
+
+    Track_Sample sample;
+    long double heading = NO_HEADING;
+    int hour, minute, day, month, year;
+    double second;
+    if(sscanf(fields[1].c_str(), "%2d%2d%lf", &hour, &minute, &second) != 3 || sscanf(fields[9].c_str(), "%2d%2d%2d", &day, &month, &year) != 3)
+    {
+      trackError(fileName, lineNumber, "invalid RMC time or date");
+      return false;
+    }
+    sample.time = daysFromCivil(2000 + year, month, day) * 86400.0 + hour * 3600 + minute * 60 + second;
+    if(!nmeaCoordinate(fields[3], fields[4], 2, sample.latitude) || !nmeaCoordinate(fields[5], fields[6], 3, sample.longitude))
+    {
+      trackError(fileName, lineNumber, "invalid RMC position");
+      return false;
+    }
+    if(!fields[8].empty() && !parseNumber(fields[8], heading))
+    {
+      trackError(fileName, lineNumber, "invalid RMC course " + fields[8]);
+      return false;
+    }
+    sample.heading = heading;
+    sample.tilt = 0;
+    track.samples.push_back(sample);
+  }
+  return true;
+}
+
+
+static bool sampleTimeCompare(const Track_Sample &a, const Track_Sample &b)
+{
+  return a.time < b.time;
+}
+
+
+// Bearing from one sample to the next, degrees clockwise from north
+static double trackBearing(const Track_Sample &from, const Track_Sample &to)
+{
+  long double north = to.latitude - from.latitude;
+  long double east = (to.longitude - from.longitude) * cos(degreeToRadiant(from.latitude));
+  double bearing = atan2((double) east, (double) north) * 180 / PI;
+  return (bearing < 0) ? bearing + 360 : bearing;
+}
+
+
+bool loadGpsTrack(const string &fileName, GPS_Track &track)
+{
+  ifstream trackFile(fileName.c_str(), ios::binary);
+  if(!trackFile.is_open())
+  {
+    cout << "Could not open track file " << fileName << "!" << endl;
+    return false;
+  }
+
+  track.samples.clear();
+  bool loaded;
+  if(hasExtension(fileName, ".gpx"))
+    loaded = loadGpxTrack(fileName, trackFile, track);
+  else if(hasExtension(fileName, ".nmea") || hasExtension(fileName, ".nma") || hasExtension(fileName, ".log"))
+    loaded = loadNmeaTrack(fileName, trackFile, track);
+  else
+    loaded = loadCsvTrack(fileName, trackFile, track);
+  if(!loaded)
+    return false;
+
+  if(track.samples.empty())
+  {
+    cout << "Track file " << fileName << " has no samples!" << endl;
+    return false;
+  }
+
+  stable_sort(track.samples.begin(), track.samples.end(), sampleTimeCompare);
+
+  // Missing headings from the direction of travel
+  size_t sampleCount = track.samples.size();
+  for(size_t sampleCounter = 0; sampleCounter < sampleCount; sampleCounter++)
+  {
+    Track_Sample &sample = track.samples[sampleCounter];
+    if(sample.heading != NO_HEADING)
+      continue;
+    if(sampleCount == 1)
+      sample.heading = 0;
+    else if(sampleCounter + 1 < sampleCount)
+      sample.heading = trackBearing(sample, track.samples[sampleCounter + 1]);
+    else
+      sample.heading = trackBearing(track.samples[sampleCounter - 1], sample);
+  }
+  return true;
+}
+
+
+// Heading difference in -180 .. 180, the short way around north
+static double headingDelta(double from, double to)
+{
+  double delta = fmod(to - from, 360.0);
+  if(delta > 180)
+    delta -= 360;
+  else if(delta < -180)
+    delta += 360;
+  return delta;
+}
+
+
+// Cubic Hermite with finite difference tangents, suited for uneven sample times
+static long double hermite(long double p0, long double p1, long double p2, long double p3, double t0, double t1, double t2, double t3, double fraction)
+{
+  double span = t2 - t1;
+  long double m1 = (t2 > t0) ? (p2 - p0) / (t2 - t0) * span : p2 - p1;
+  long double m2 = (t3 > t1) ? (p3 - p1) / (t3 - t1) * span : p2 - p1;
+  long double f = fraction;
+  long double f2 = f * f;
+  long double f3 = f2 * f;
+  return (2 * f3 - 3 * f2 + 1) * p1 + (f3 - 2 * f2 + f) * m1 + (-2 * f3 + 3 * f2) * p2 + (f3 - f2) * m2;
+}
+
+
+void trackPoseAt(const GPS_Track &track, double time, int interpolation, double defaultTilt, Camera_Pose &pose)
+{
+  const vector<Track_Sample> &samples = track.samples;
+  vector<Track_Sample>::const_iterator upper = upper_bound(samples.begin(), samples.end(), time, [](double value, const Track_Sample &sample) { return value < sample.time; });
+
+  size_t next = upper - samples.begin();
+  if(next == 0 || next == samples.size())
+  {
+    const Track_Sample &sample = (next == 0) ? samples.front() : samples.back();
+    pose.latitude = sample.latitude;
+    pose.longitude = sample.longitude;
+    pose.direction = sample.heading;
+    pose.tilt = track.hasTilt ? sample.tilt : defaultTilt;
+    return;
+  }
+
+  const Track_Sample &before = samples[next - 1];
+  const Track_Sample &after = samples[next];
+  double span = after.time - before.time;
+  double fraction = (span > 0) ? (time - before.time) / span : 0;
+
+  if(interpolation == TRACK_INTERPOLATION_CUBIC)
+  {
+    const Track_Sample &first = samples[(next >= 2) ? next - 2 : next - 1];
+    const Track_Sample &last = samples[(next + 1 < samples.size()) ? next + 1 : next];
+    pose.latitude = hermite(first.latitude, before.latitude, after.latitude, last.latitude, first.time, before.time, after.time, last.time, fraction);
+    pose.longitude = hermite(first.longitude, before.longitude, after.longitude, last.longitude, first.time, before.time, after.time, last.time, fraction);
+  }
+  else
+  {
+    pose.latitude = before.latitude + (after.latitude - before.latitude) * fraction;
+    pose.longitude = before.longitude + (after.longitude - before.longitude) * fraction;
+  }
+
+  double direction = before.heading + headingDelta(before.heading, after.heading) * fraction;
+  pose.direction = (direction < 0) ? direction + 360 : fmod(direction, 360.0);
+  pose.tilt = track.hasTilt ? before.tilt + (after.tilt - before.tilt) * fraction : defaultTilt;
+}
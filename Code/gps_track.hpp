@@ -0,0 +1,36 @@
+#ifndef GPS_TRACK_HPP
+#define GPS_TRACK_HPP
+
+#include <string>
+#include <vector>
+
+#include "camera_projection.hpp"
+
+#define TRACK_INTERPOLATION_LINEAR 0
+#define TRACK_INTERPOLATION_CUBIC 1 // Hermite spline through the samples, heading and tilt stay linear
+
+struct Track_Sample {
+  double time;  // Seconds, absolute for GPX and NMEA, as written in the file for CSV
+  long double latitude;
+  long double longitude;
+  double heading; // Degrees clockwise from north, like the camera direction
+  double tilt;
+};
+
+struct GPS_Track {
+  std::vector<Track_Sample> samples;  // Sorted by time
+  bool hasTilt; // Otherwise the tilt of the overlay context is used
+};
+
+// Reads a CSV, GPX or NMEA track, picked by the file extension.
+// CSV lines: time;latitude;longitude;heading[;tilt], ',' works as separator
+// too, a header line is skipped. The time is in seconds or ISO 8601.
+// Samples without a heading get the bearing to their neighbour.
+// Returns false and prints the file and line on errors.
+bool loadGpsTrack(const std::string &fileName, GPS_Track &track);
+
+// Pose at the given track time in O(log n), times outside the track are
+// clamped to the first or last sample
+void trackPoseAt(const GPS_Track &track, double time, int interpolation, double defaultTilt, Camera_Pose &pose);
+
+#endif /* GPS_TRACK_HPP */
@@ -0,0 +1,296 @@
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mask_stream.hpp"
+
+using namespace std;
+using namespace cv;
+
+#define MASK_STREAM_MAGIC "RLEMASK"
+#define MASK_STREAM_BYTE_ORDER 0x01020304u
+
+
+Mask_Writer::Mask_Writer() : file(NULL), position(0), failed(false)
+{
+}
+
+
+Mask_Writer::~Mask_Writer()
+{
+  if(file)
+    finish();
+}
+
+
+bool Mask_Writer::open(const string &fileName, int frameWidth, int frameHeight)
+{
+  if(frameWidth <= 0 || frameHeight <= 0 || frameWidth > MASK_STREAM_MAX_SIZE || frameHeight > MASK_STREAM_MAX_SIZE)
+  {
+    cout << "Masks of " << frameWidth << "x" << frameHeight << " frames are not supported, at most " << MASK_STREAM_MAX_SIZE << " pixels per side" << endl;
+    return false;
+  }
+  file = fopen(fileName.c_str(), "wb");
+  if(!file)
+  {
+    cout << "Could not write mask stream " << fileName << endl;
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, 1 << 20);
+  this->fileName = fileName;
+
+  // The header is written again by finish, until then frameCount and indexOffset stay 0
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MASK_STREAM_MAGIC, sizeof(header.magic));
+  header.version = MASK_STREAM_VERSION;
+  header.byteOrder = MASK_STREAM_BYTE_ORDER;
+  header.frameWidth = frameWidth;
+  header.frameHeight = frameHeight;
+  frames.clear();
+  failed = (fwrite(&header, sizeof(header), 1, file) != 1);
+  position = sizeof(header);
+  return !failed;
+}
+
+
+// Appends the runs of one row, nothing for a row without matches
+static uint32_t encodeMaskRow(const uchar *row, int width, int y, vector<uint16_t> &record)
+{
+  size_t rowStart = record.size();
+  uint32_t runCount = 0;
+  int column = 0;
+  while(column < width)
+  {
+    // Most of a row is empty, skip it eight pixels at a time
+    while(column + 8 <= width)
+    {
+      uint64_t pixels;
+      memcpy(&pixels, row + column, sizeof(pixels));
+      if(pixels != 0)
+        break;
+      column += 8;
+    }
+    while(column < width && row[column] == 0)
+      column++;
+    if(column >= width)
+      break;
+
+    int runStart = column;
+    while(column < width && row[column] != 0)
+      column++;
+    if(runCount == 0)
+    {
+      record.push_back(y);
+      record.push_back(0);
+    }
+    record.push_back(runStart);
+    record.push_back(column - runStart);
+    runCount++;
+  }
+  if(runCount > 0)
+    record[rowStart + 1] = runCount;
+  return runCount;
+}
+
+
+bool Mask_Writer::write(int frameIndex, const Mat &mask)
+{
+  if(!file || mask.type() != CV_8UC1 || mask.cols != (int) header.frameWidth || mask.rows != (int) header.frameHeight)
+    return false;
+
+  static thread_local vector<uint16_t> record;
+  record.clear();
+  Mask_Frame_Entry entry;
+  entry.frameIndex = frameIndex;
+  entry.runCount = 0;
+  for(int y = 0; y < mask.rows; y++)
+    entry.runCount += encodeMaskRow(mask.ptr<uchar>(y), mask.cols, y, record);
+  entry.size = record.size() * sizeof(uint16_t);
+
+  lock_guard<mutex> lock(fileMutex);
+  if(failed)
+    return false;
+  entry.offset = position;
+  if(entry.size > 0 && fwrite(record.data(), 1, entry.size, file) != entry.size)
+  {
+    cout << "Could not write mask stream " << fileName << endl;
+    failed = true;
+    return false;
+  }
+  position += entry.size;
+  frames.push_back(entry);
+  return true;
+}
+
+
+static bool compareMaskFrames(const Mask_Frame_Entry &first, const Mask_Frame_Entry &second)
+{
+  return first.frameIndex < second.frameIndex;
+}
+
+
+bool Mask_Writer::finish()
+{
+  if(!file)
+    return false;
+  bool written = !failed;
+  if(written)
+  {
+    // The table is aligned, so a reader can use it in place
+    static const char padding[sizeof(uint64_t)] = {0};
+    size_t paddingSize = (sizeof(uint64_t) - position % sizeof(uint64_t)) % sizeof(uint64_t);
+    sort(frames.begin(), frames.end(), compareMaskFrames);
+    header.frameCount = frames.size();
+    header.indexOffset = position + paddingSize;
+    header.fileSize = header.indexOffset + frames.size() * sizeof(Mask_Frame_Entry);
+    written = (fwrite(padding, 1, paddingSize, file) == paddingSize)
+      && (frames.empty() || fwrite(frames.data(), sizeof(Mask_Frame_Entry), frames.size(), file) == frames.size())
+      && (fseek(file, 0, SEEK_SET) == 0)
+      && (fwrite(&header, sizeof(header), 1, file) == 1);
+    position = header.fileSize;
+  }
+  written = (fclose(file) == 0) && written;
+  file = NULL;
+  if(!written)
+    cout << "Could not finish mask stream " << fileName << endl;
+  return written;
+}
+
+
+bool openMaskReader(const string &fileName, Mask_Reader &reader)
+{
+  reader.mapping = NULL;
+  reader.mappingSize = 0;
+  reader.frames = NULL;
+  reader.frameCount = 0;
+
+  int file = open(fileName.c_str(), O_RDONLY);
+  if(file < 0)
+  {
+    cout << "Could not open mask stream " << fileName << endl;
+    return false;
+  }
+  struct stat fileStat;
+  void *mapping = MAP_FAILED;
+  size_t size = 0;
+  if(fstat(file, &fileStat) == 0 && (size_t) fileStat.st_size >= sizeof(Mask_Stream_Header))
+  {
+    size = fileStat.st_size;
+    mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+  }
+  close(file);
+  if(mapping == MAP_FAILED)
+  {
+    cout << "Mask stream " << fileName << " is empty or can not be mapped" << endl;
+    return false;
+  }
+
+  const char *data = (const char *) mapping;
+  const Mask_Stream_Header &header = *(const Mask_Stream_Header *) data;
+  bool valid = (memcmp(header.magic, MASK_STREAM_MAGIC, sizeof(header.magic)) == 0)
+    && (header.version == MASK_STREAM_VERSION)
+    && (header.byteOrder == MASK_STREAM_BYTE_ORDER)
+    && (header.frameWidth <= MASK_STREAM_MAX_SIZE)
+    && (header.frameHeight <= MASK_STREAM_MAX_SIZE)
+    && (header.fileSize == size)
+    && (header.indexOffset >= sizeof(Mask_Stream_Header))
+    && (header.indexOffset % sizeof(uint64_t) == 0)
+    && (header.indexOffset <= size)
+    && (header.frameCount == (size - header.indexOffset) / sizeof(Mask_Frame_Entry))
+    && ((size - header.indexOffset) % sizeof(Mask_Frame_Entry) == 0);
+
+  // The records have to lie between the header and the index table
+  const Mask_Frame_Entry *frames = (const Mask_Frame_Entry *) (data + header.indexOffset);
+  for(size_t frameCounter = 0; valid && frameCounter < header.frameCount; frameCounter++)
+  {
+    const Mask_Frame_Entry &entry = frames[frameCounter];
+    valid = (entry.offset >= sizeof(Mask_Stream_Header)) && (entry.offset % sizeof(uint16_t) == 0)
+      && (entry.offset <= header.indexOffset) && (entry.size <= header.indexOffset - entry.offset)
+      && (frameCounter == 0 || frames[frameCounter - 1].frameIndex < entry.frameIndex);
+  }
+  if(!valid)
+  {
+    cout << "Mask stream " << fileName << " is unfinished or damaged" << endl;
+    munmap(mapping, size);
+    return false;
+  }
+
+  reader.mapping = mapping;
+  reader.mappingSize = size;
+  reader.frameWidth = header.frameWidth;
+  reader.frameHeight = header.frameHeight;
+  reader.frames = frames;
+  reader.frameCount = header.frameCount;
+  return true;
+}
+
+
+static const Mask_Frame_Entry *findMaskFrame(const Mask_Reader &reader, int frameIndex)
+{
+  Mask_Frame_Entry key;
+  key.frameIndex = frameIndex;
+  const Mask_Frame_Entry *end = reader.frames + reader.frameCount;
+  const Mask_Frame_Entry *entry = lower_bound(reader.frames, end, key, compareMaskFrames);
+  if(entry == end || entry->frameIndex != frameIndex)
+    return NULL;
+  return entry;
+}
+
+
+bool readMaskRuns(const Mask_Reader &reader, int frameIndex, vector<Mask_Run> &runs)
+{
+  runs.clear();
+  const Mask_Frame_Entry *entry = findMaskFrame(reader, frameIndex);
+  if(!entry)
+    return false;
+
+  const uint16_t *record = (const uint16_t *) ((const char *) reader.mapping + entry->offset);
+  size_t recordSize = entry->size / sizeof(uint16_t);
+  size_t position = 0;
+  runs.reserve(entry->runCount);
+  while(position + 2 <= recordSize)
+  {
+    int y = record[position];
+    size_t runCount = record[position + 1];
+    position += 2;
+    if(runCount > (recordSize - position) / 2 || y >= reader.frameHeight)
+      return false;
+    for(size_t runCounter = 0; runCounter < runCount; runCounter++, position += 2)
+    {
+      Mask_Run run = {y, record[position], record[position + 1]};
+      if(run.x + run.length > reader.frameWidth)
+        return false;
+      runs.push_back(run);
+    }
+  }
+  return true;
+}
+
+
+bool readMaskImage(const Mask_Reader &reader, int frameIndex, Mat &mask)
+{
+  vector<Mask_Run> runs;
+  if(!readMaskRuns(reader, frameIndex, runs))
+    return false;
+  mask.create(reader.frameHeight, reader.frameWidth, CV_8UC1);
+  mask.setTo(0);
+  for(size_t runCounter = 0; runCounter < runs.size(); runCounter++)
+    memset(mask.ptr<uchar>(runs[runCounter].y) + runs[runCounter].x, 255, runs[runCounter].length);
+  return true;
+}
+
+
+void closeMaskReader(Mask_Reader &reader)
+{
+  if(reader.mapping)
+    munmap(reader.mapping, reader.mappingSize);
+  reader.mapping = NULL;
+  reader.mappingSize = 0;
+  reader.frames = NULL;
+  reader.frameCount = 0;
+}
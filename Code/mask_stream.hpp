@@ -0,0 +1,112 @@
+#ifndef MASK_STREAM_HPP
+#define MASK_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#define MASK_STREAM_VERSION 1
+#define MASK_STREAM_MAX_SIZE 65535  // Coordinates are stored as uint16_t
+
+/********************************/
+/*** Run length encoded masks ***/
+/********************************/
+// The matched pixels of every frame as runs per image row, a small sidecar
+// instead of a re-encoded video for tools that only need the plan pixels.
+//
+// Layout: Mask_Stream_Header, the frame records in the order they were
+// written, then the frame index table sorted by frame and aligned to 8
+// bytes. A frame record is a list of rows, each uint16_t y, uint16_t
+// runCount and runCount times uint16_t x, uint16_t length, rows ascending by
+// y, runs by x. A frame without matches has an empty record, frames not in
+// the table were not processed.
+struct Mask_Stream_Header {
+  char magic[8];  // "RLEMASK"
+  uint32_t version;
+  uint32_t byteOrder; // 0x01020304 as written by the host
+  uint32_t frameWidth;
+  uint32_t frameHeight;
+  uint64_t frameCount;  // Entries of the index table, 0 until the stream is finished
+  uint64_t indexOffset;
+  uint64_t fileSize;
+};
+
+struct Mask_Frame_Entry {
+  int32_t frameIndex; // Index in the whole video
+  uint32_t runCount;
+  uint64_t offset;  // Of the frame record
+  uint64_t size;  // Bytes of the frame record
+};
+
+struct Mask_Run {
+  int y;
+  int x;
+  int length;
+};
+
+
+/**************/
+/*** Writer ***/
+/**************/
+// Frames may come from any thread and in any order, each is encoded on the
+// calling thread and only appending it to the file is serialized.
+class Mask_Writer {
+public:
+  Mask_Writer();
+  ~Mask_Writer();
+
+  // False and prints the reason if the file can not be written
+  bool open(const std::string &fileName, int frameWidth, int frameHeight);
+
+  // Mask of CV_8UC1 with the frame size, every pixel != 0 is matched
+  bool write(int frameIndex, const cv::Mat &mask);
+
+  // Appends the index table and completes the header, a stream without it is unreadable
+  bool finish();
+
+  bool isOpen() const { return file != NULL; }
+  uint64_t framesWritten() const { return frames.size(); }
+  uint64_t bytesWritten() const { return position; }
+
+private:
+  FILE *file;
+  std::string fileName;
+  Mask_Stream_Header header;
+  std::mutex fileMutex;
+  std::vector<Mask_Frame_Entry> frames;
+  uint64_t position;
+  bool failed;
+};
+
+
+/**************/
+/*** Reader ***/
+/**************/
+// Maps a finished stream, the frames can be read in any order
+struct Mask_Reader {
+  void *mapping;
+  size_t mappingSize;
+  int frameWidth;
+  int frameHeight;
+  const Mask_Frame_Entry *frames; // Sorted by frameIndex
+  size_t frameCount;
+};
+
+// False and prints the reason if the file is missing, unfinished or damaged
+bool openMaskReader(const std::string &fileName, Mask_Reader &reader);
+
+// Runs of one frame, ordered by y and x. False if the frame is not in the
+// stream or its record is damaged.
+bool readMaskRuns(const Mask_Reader &reader, int frameIndex, std::vector<Mask_Run> &runs);
+
+// CV_8UC1 of the frame size with 255 on the matched pixels
+bool readMaskImage(const Mask_Reader &reader, int frameIndex, cv::Mat &mask);
+
+void closeMaskReader(Mask_Reader &reader);
+
+#endif /* MASK_STREAM_HPP */
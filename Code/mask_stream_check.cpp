@@ -0,0 +1,153 @@
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "mask_stream.hpp"
+
+using namespace std;
+using namespace cv;
+
+#define MASK_CHECK_WIDTH 333  // Not a multiple of 8, the encoder skips empty pixels 8 at a time
+#define MASK_CHECK_HEIGHT 61
+#define MASK_CHECK_FRAMES 48
+#define MASK_CHECK_THREADS 4
+#define MASK_CHECK_MISSING_FRAME 17 // Never written, the reader has to report it as missing
+#define MASK_CHECK_FILE "mask_stream_check.rle"
+
+
+// Masks with the awkward cases: empty frames, runs touching column 0 and
+// width - 1, a full row, single pixels and pseudo random pixels
+static void buildCheckMask(int frameCounter, Mat &mask)
+{
+  mask.create(MASK_CHECK_HEIGHT, MASK_CHECK_WIDTH, CV_8UC1);
+  mask.setTo(0);
+  if(frameCounter % 6 == 0)
+    return;
+
+  unsigned int state = 2166136261u ^ frameCounter;
+  for(int y = 0; y < mask.rows; y++)
+  {
+    uchar *row = mask.ptr<uchar>(y);
+    if(y == frameCounter % mask.rows)
+    {
+      memset(row, 1, mask.cols);
+      continue;
+    }
+    if(y % 5 == 0)
+      row[0] = 255;
+    if(y % 7 == 0)
+      row[mask.cols - 1] = 3;
+    if(y % 3 == 1)
+      memset(row + mask.cols - 9, 1, 9);
+    for(int x = 0; x < mask.cols; x++)
+    {
+      state = state * 1103515245u + 12345u;
+      if(((state >> 16) % 100) < (unsigned int) (frameCounter % 5) * 4)
+        row[x] = 1 + (state >> 24) % 255;
+    }
+  }
+}
+
+
+static long long compareCheckMasks(const Mat &expected, const Mat &decoded)
+{
+  long long mismatches = 0;
+  for(int y = 0; y < expected.rows; y++)
+  {
+    for(int x = 0; x < expected.cols; x++)
+    {
+      bool expectedPixel = expected.at<uchar>(y, x) != 0;
+      bool decodedPixel = decoded.at<uchar>(y, x) == 255;
+      if(expectedPixel != decodedPixel || (!decodedPixel && decoded.at<uchar>(y, x) != 0))
+        mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+
+int main(int argc, char **argv)
+{
+  string fileName = (argc > 1) ? argv[1] : MASK_CHECK_FILE;
+
+  vector<Mat> masks(MASK_CHECK_FRAMES);
+  for(int frameCounter = 0; frameCounter < MASK_CHECK_FRAMES; frameCounter++)
+    buildCheckMask(frameCounter, masks[frameCounter]);
+
+  // Every thread writes its frames backwards, the stream gets them out of order
+  Mask_Writer writer;
+  if(!writer.open(fileName, MASK_CHECK_WIDTH, MASK_CHECK_HEIGHT))
+    return -1;
+  vector<thread> threads;
+  for(int threadCounter = 0; threadCounter < MASK_CHECK_THREADS; threadCounter++)
+  {
+    threads.push_back(thread([&, threadCounter]()
+    {
+      for(int frameCounter = MASK_CHECK_FRAMES - 1 - threadCounter; frameCounter >= 0; frameCounter -= MASK_CHECK_THREADS)
+      {
+        if(frameCounter != MASK_CHECK_MISSING_FRAME)
+          writer.write(frameCounter, masks[frameCounter]);
+      }
+    }));
+  }
+  for(size_t threadCounter = 0; threadCounter < threads.size(); threadCounter++)
+    threads[threadCounter].join();
+  if(!writer.finish())
+    return -1;
+
+  Mask_Reader reader;
+  if(!openMaskReader(fileName, reader))
+    return 1;
+
+  int failures = 0;
+  if(reader.frameWidth != MASK_CHECK_WIDTH || reader.frameHeight != MASK_CHECK_HEIGHT || reader.frameCount != MASK_CHECK_FRAMES - 1)
+  {
+    cout << "FAILED: stream of " << reader.frameWidth << " x " << reader.frameHeight << " with " << reader.frameCount << " frames" << endl;
+    failures++;
+  }
+
+  Mat decoded;
+  for(int frameCounter = 0; frameCounter < MASK_CHECK_FRAMES; frameCounter++)
+  {
+    bool found = readMaskImage(reader, frameCounter, decoded);
+    if(frameCounter == MASK_CHECK_MISSING_FRAME)
+    {
+      if(found)
+      {
+        cout << "FAILED: frame " << frameCounter << " was never written but is in the stream" << endl;
+        failures++;
+      }
+      continue;
+    }
+    if(!found)
+    {
+      cout << "FAILED: frame " << frameCounter << " is missing" << endl;
+      failures++;
+      continue;
+    }
+    long long mismatches = compareCheckMasks(masks[frameCounter], decoded);
+    if(mismatches > 0)
+    {
+      cout << "FAILED: frame " << frameCounter << " differs in " << mismatches << " pixels" << endl;
+      failures++;
+    }
+  }
+  if(readMaskImage(reader, -1, decoded) || readMaskImage(reader, MASK_CHECK_FRAMES, decoded))
+  {
+    cout << "FAILED: frames outside the written range are in the stream" << endl;
+    failures++;
+  }
+
+  cout << "Mask stream: " << reader.frameCount << " frames in " << reader.mappingSize << " bytes" << endl;
+  closeMaskReader(reader);
+  remove(fileName.c_str());
+  if(failures > 0)
+    return 1;
+  cout << "PASSED" << endl;
+  return 0;
+}
@@ -0,0 +1,361 @@
+#include <iostream>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "plan_types.hpp"
+#include "plan_index.hpp"
+#include "plan_loader.hpp"
+#include "plan_raster.hpp"
+#include "camera_projection.hpp"
+#include "projection_math.hpp"
+#include "column_kernel.hpp"
+#include "frame_overlay.hpp"
+#include "pose_source.hpp"
+
+using namespace std;
+using namespace cv;
+
+#define EQUIVALENCE_LOCATIONS 10  // Mismatching pixels listed per engine
+#define EQUIVALENCE_ROW_THREADS 4
+#define EQUIVALENCE_BITMAP_MAX_BYTES (256 * 1024 * 1024) // Larger plans test the hash set twice
+
+// Camera path of VIDEO2 in read_video_to_images.cpp
+#define EQUIVALENCE_LATITUDE_START 48.378986
+#define EQUIVALENCE_LONGITUDE_START 16.825719
+#define EQUIVALENCE_LATITUDE_END 48.378914
+#define EQUIVALENCE_LONGITUDE_END 16.825755
+#define EQUIVALENCE_DIRECTION 150
+#define EQUIVALENCE_TILT 89
+
+#define EQUIVALENCE_INDEX_NONE -1 // comparePositionToLineMark
+
+struct Equivalence_Engine {
+  const char *name;
+  int indexType;  // PLAN_INDEX_HASH, _BITMAP, _SORTED or EQUIVALENCE_INDEX_NONE
+  int columnKernel;
+  int rowThreads;
+};
+
+// Mismatches of one engine against the golden masks. Pixels the engine
+// marks in addition to the golden path are fine if an exact lookup of the
+// golden markers marks them too, comparePositionToLineMark skips the
+// markers at the borders of its 19 buckets.
+struct Equivalence_Result {
+  int framesCompared;
+  int framesMismatching;  // Frames with missing or extra pixels
+  long long missingPixels;  // Red in the golden mask only
+  long long extraPixels;  // Red in the engine mask only, not a marker
+  long long scanMissPixels;  // Red in the engine mask only, missed by the reference scan
+  int locationsListed;
+};
+
+static const Equivalence_Engine equivalenceEngines[] = {
+  {"hash", PLAN_INDEX_HASH, OVERLAY_KERNEL_NONE, 1},
+  {"bitmap", PLAN_INDEX_BITMAP, OVERLAY_KERNEL_NONE, 1},
+  {"sorted", PLAN_INDEX_SORTED, OVERLAY_KERNEL_NONE, 1},
+  {"simd", PLAN_INDEX_BITMAP, OVERLAY_KERNEL_SIMD, 1},
+  {"fixed-point", PLAN_INDEX_BITMAP, OVERLAY_KERNEL_FIXED_POINT, 1},
+  {"rows", PLAN_INDEX_BITMAP, OVERLAY_KERNEL_SIMD, EQUIVALENCE_ROW_THREADS}
+};
+#define EQUIVALENCE_ENGINE_COUNT ((int) (sizeof(equivalenceEngines) / sizeof(equivalenceEngines[0])))
+
+
+static void printEquivalenceUsage(const char *programName)
+{
+  cout << "Usage: " << programName << " <plan file> <video file> [options]" << endl;
+  cout << "  Compares the overlay masks of the optimized engines with SOLUTION_2 and comparePositionToLineMark" << endl;
+  cout << "  --engine <name>    Only this engine, one of";
+  for(int engineCounter = 0; engineCounter < EQUIVALENCE_ENGINE_COUNT; engineCounter++)
+    cout << " " << equivalenceEngines[engineCounter].name;
+  cout << endl;
+  cout << "  --max-frames <n>   Stop after n frames" << endl;
+  cout << "  --step <n>         Compare every n. frame only" << endl;
+  cout << "  Exits with 1 if an engine misses a golden pixel or marks a pixel that is no marker" << endl;
+}
+
+
+// Red pixels of the canvas, the overlay draws (0, 0, 255) onto black
+static void maskOfCanvas(const Mat &canvas, Mat &mask)
+{
+  mask.create(canvas.rows, canvas.cols, CV_8UC1);
+  for(int y = 0; y < canvas.rows; y++)
+  {
+    const Vec3b *canvasRow = canvas.ptr<Vec3b>(y);
+    unsigned char *maskRow = mask.ptr<unsigned char>(y);
+    for(int x = 0; x < canvas.cols; x++)
+      maskRow[x] = (canvasRow[x][0] == 0 && canvasRow[x][1] == 0 && canvasRow[x][2] == 255) ? 1 : 0;
+  }
+}
+
+
+static void compareMasks(const Mat &golden, const Mat &exact, const Mat &mask, int frameCounter, const char *engineName, Equivalence_Result &result)
+{
+  long long mismatches = 0;
+  for(int y = 0; y < golden.rows; y++)
+  {
+    const unsigned char *goldenRow = golden.ptr<unsigned char>(y);
+    const unsigned char *exactRow = exact.ptr<unsigned char>(y);
+    const unsigned char *maskRow = mask.ptr<unsigned char>(y);
+    for(int x = 0; x < golden.cols; x++)
+    {
+      if(goldenRow[x] == maskRow[x])
+        continue;
+      if(!goldenRow[x] && exactRow[x])
+      {
+        result.scanMissPixels++;
+        continue;
+      }
+      mismatches++;
+      if(goldenRow[x])
+        result.missingPixels++;
+      else
+        result.extraPixels++;
+      if(result.locationsListed < EQUIVALENCE_LOCATIONS)
+      {
+        cout << "  " << engineName << ": frame " << frameCounter << " x " << x << " y " << y << (goldenRow[x] ? " missing" : " extra") << endl;
+        result.locationsListed++;
+      }
+    }
+  }
+  result.framesCompared++;
+  if(mismatches > 0)
+    result.framesMismatching++;
+}
+
+
+/********************/
+/*** Main routine ***/
+/********************/
+int main(int argc, char **argv)
+{
+  string planFileName;
+  string videoFileName;
+  string engineName;
+  int maxFrames = -1;
+  int step = 1;
+  int positionalCounter = 0;
+  for(int argumentCounter = 1; argumentCounter < argc; argumentCounter++)
+  {
+    const char *argument = argv[argumentCounter];
+    if((strcmp(argument, "--engine") == 0 || strcmp(argument, "--max-frames") == 0 || strcmp(argument, "--step") == 0) && argumentCounter + 1 < argc)
+    {
+      const char *value = argv[++argumentCounter];
+      if(strcmp(argument, "--engine") == 0)
+        engineName = value;
+      else if(strcmp(argument, "--max-frames") == 0)
+        maxFrames = atoi(value);
+      else
+        step = max(1, atoi(value));
+    }
+    else if(strncmp(argument, "--", 2) != 0 && positionalCounter == 0)
+    {
+      planFileName = argument;
+      positionalCounter++;
+    }
+    else if(strncmp(argument, "--", 2) != 0 && positionalCounter == 1)
+    {
+      videoFileName = argument;
+      positionalCounter++;
+    }
+    else
+    {
+      printEquivalenceUsage(argv[0]);
+      return -1;
+    }
+  }
+  if(positionalCounter < 2)
+  {
+    printEquivalenceUsage(argv[0]);
+    return -1;
+  }
+
+  bool engineSelected[EQUIVALENCE_ENGINE_COUNT];
+  bool engineFound = engineName.empty();
+  for(int engineCounter = 0; engineCounter < EQUIVALENCE_ENGINE_COUNT; engineCounter++)
+  {
+    engineSelected[engineCounter] = engineName.empty() || engineName == equivalenceEngines[engineCounter].name;
+    engineFound |= engineSelected[engineCounter];
+  }
+  if(!engineFound)
+  {
+    cout << "Unknown engine " << engineName << endl;
+    printEquivalenceUsage(argv[0]);
+    return -1;
+  }
+
+
+  /*** Plan, golden path as in the original code: rasterized and sorted by latitude ***/
+  vector<GPS_Point> gpsPoints;
+  if(!loadPlanFile(planFileName, gpsPoints))
+    return -1;
+  vector<Line_Marking_Points> goldenMarks;
+  rasterizePlan(gpsPoints.data(), gpsPoints.size(), goldenMarks);
+  sort(goldenMarks.begin(), goldenMarks.end(), lineMarkCompare);
+  size_t goldenSize = goldenMarks.size();
+  if(goldenSize < 19)
+  {
+    cout << "comparePositionToLineMark needs at least 19 markers, the plan has " << goldenSize << endl;
+    return -1;
+  }
+  // Same markers without the bucket borders of the reference scan, the
+  // markers are not fully ordered so this is always the hash set
+  Plan_Index exactIndex;
+  buildPlanIndex(exactIndex, goldenMarks.data(), goldenSize, 0, (size_t) -1);
+  // comparePositionToLineMark reads up to goldenSize / 19 markers behind the end
+  Line_Marking_Points sentinel;
+  sentinel.latitude = INT_MAX;
+  sentinel.longitude = INT_MAX;
+  goldenMarks.insert(goldenMarks.end(), goldenSize / 19 + 1, sentinel);
+
+  // The optimized engines get the markers as read_video_to_images builds them
+  vector<Line_Marking_Points> lineMarks;
+  rasterizePlan(gpsPoints.data(), gpsPoints.size(), lineMarks);
+  sortUniqueLineMarks(lineMarks);
+  Plan_Index hashIndex;
+  Plan_Index bitmapIndex;
+  Plan_Index sortedIndex;
+  buildPlanIndex(hashIndex, lineMarks.data(), lineMarks.size(), 0, (size_t) -1);
+  buildPlanIndex(bitmapIndex, lineMarks.data(), lineMarks.size(), EQUIVALENCE_BITMAP_MAX_BYTES, (size_t) -1);
+  buildPlanIndex(sortedIndex, lineMarks.data(), lineMarks.size(), 0, 0);
+
+
+  /*** Video, only frame size, count and timestamps are used ***/
+  VideoCapture video(videoFileName);
+  if(!video.isOpened())
+  {
+    cout << "Could not open video!" << endl;
+    return -1;
+  }
+  int frameWidth = video.get(CAP_PROP_FRAME_WIDTH);
+  int frameHeight = video.get(CAP_PROP_FRAME_HEIGHT);
+  double frameCount = video.get(CAP_PROP_FRAME_COUNT);
+  if(frameCount <= 0)
+  {
+    cout << "The video does not report its frame count!" << endl;
+    return -1;
+  }
+
+  Pose_Source poseSource;
+  poseSource.track = NULL;
+  poseSource.latitudeStart = EQUIVALENCE_LATITUDE_START;
+  poseSource.longitudeStart = EQUIVALENCE_LONGITUDE_START;
+  poseSource.latitudeEnd = EQUIVALENCE_LATITUDE_END;
+  poseSource.longitudeEnd = EQUIVALENCE_LONGITUDE_END;
+  poseSource.pathFrames = frameCount;
+  poseSource.direction = EQUIVALENCE_DIRECTION;
+  poseSource.tilt = EQUIVALENCE_TILT;
+
+  Overlay_Context goldenContext;
+  goldenContext.settings.solution1 = false;
+  goldenContext.settings.solution2 = true;
+  goldenContext.settings.solution3 = false;
+  goldenContext.settings.solution4 = false;
+  goldenContext.settings.planLookup = OVERLAY_LOOKUP_REFERENCE;
+  goldenContext.settings.columnKernel = OVERLAY_KERNEL_NONE;
+  goldenContext.settings.rowThreads = 1;
+  goldenContext.settings.mask = false;
+  goldenContext.gpsPoint = gpsPoints.data();
+  goldenContext.dataCounter = gpsPoints.size();
+  goldenContext.lineMark = goldenMarks.data();
+  goldenContext.markingSize = goldenSize;
+  goldenContext.planIndex = NULL;
+  goldenContext.tilt = EQUIVALENCE_TILT;
+  buildCameraGeometry(goldenContext.cameraGeometry, EQUIVALENCE_TILT, frameWidth, frameHeight);
+  Overlay_Worker goldenWorker;
+  initOverlayWorker(goldenWorker, goldenContext);
+
+  Overlay_Context exactContext = goldenContext;
+  exactContext.settings.planLookup = OVERLAY_LOOKUP_INDEX;
+  exactContext.planIndex = &exactIndex;
+  Overlay_Worker exactWorker;
+  initOverlayWorker(exactWorker, exactContext);
+  long long goldenPixels = 0;
+  long long scanMissPixels = 0;
+
+  Overlay_Context engineContexts[EQUIVALENCE_ENGINE_COUNT];
+  Overlay_Worker engineWorkers[EQUIVALENCE_ENGINE_COUNT];
+  Equivalence_Result results[EQUIVALENCE_ENGINE_COUNT];
+  for(int engineCounter = 0; engineCounter < EQUIVALENCE_ENGINE_COUNT; engineCounter++)
+  {
+    const Equivalence_Engine &engine = equivalenceEngines[engineCounter];
+    Overlay_Context &context = engineContexts[engineCounter];
+    context = goldenContext;
+    context.settings.planLookup = OVERLAY_LOOKUP_INDEX;
+    context.settings.columnKernel = engine.columnKernel;
+    context.settings.rowThreads = engine.rowThreads;
+    context.lineMark = lineMarks.data();
+    context.markingSize = lineMarks.size();
+    if(engine.indexType == PLAN_INDEX_HASH)
+      context.planIndex = &hashIndex;
+    else if(engine.indexType == PLAN_INDEX_SORTED)
+      context.planIndex = &sortedIndex;
+    else
+      context.planIndex = &bitmapIndex;
+    initOverlayWorker(engineWorkers[engineCounter], context);
+    memset(&results[engineCounter], 0, sizeof(results[engineCounter]));
+  }
+
+  cout << "Plan: " << planFileName << ", " << goldenSize << " markers (" << lineMarks.size() << " unique)" << endl;
+  cout << "Video: " << videoFileName << ", " << frameWidth << " x " << frameHeight << ", " << frameCount << " frames" << endl;
+
+
+  /*** Golden mask and engine masks of every frame ***/
+  Mat frame;
+  Mat canvas(frameHeight, frameWidth, CV_8UC3);
+  Mat goldenMask;
+  Mat exactMask;
+  Mat engineMask;
+  for(int frameCounter = 0; (maxFrames < 0 || frameCounter < maxFrames) && video.read(frame); frameCounter++)
+  {
+    if(frameCounter % step != 0)
+      continue;
+    Camera_Pose pose;
+    poseOfFrame(poseSource, frameCounter, video.get(CAP_PROP_POS_MSEC), pose);
+
+    canvas.setTo(Scalar(0, 0, 0));
+    overlayFrame(canvas, goldenContext, pose, goldenWorker, frameCounter);
+    maskOfCanvas(canvas, goldenMask);
+    canvas.setTo(Scalar(0, 0, 0));
+    overlayFrame(canvas, exactContext, pose, exactWorker, frameCounter);
+    maskOfCanvas(canvas, exactMask);
+    for(int y = 0; y < goldenMask.rows; y++)
+    {
+      for(int x = 0; x < goldenMask.cols; x++)
+      {
+        goldenPixels += goldenMask.at<unsigned char>(y, x);
+        scanMissPixels += !goldenMask.at<unsigned char>(y, x) && exactMask.at<unsigned char>(y, x);
+      }
+    }
+
+    for(int engineCounter = 0; engineCounter < EQUIVALENCE_ENGINE_COUNT; engineCounter++)
+    {
+      if(!engineSelected[engineCounter])
+        continue;
+      canvas.setTo(Scalar(0, 0, 0));
+      overlayFrame(canvas, engineContexts[engineCounter], pose, engineWorkers[engineCounter], frameCounter);
+      maskOfCanvas(canvas, engineMask);
+      compareMasks(goldenMask, exactMask, engineMask, frameCounter, equivalenceEngines[engineCounter].name, results[engineCounter]);
+    }
+  }
+
+
+  /*** Report ***/
+  cout << "Golden: " << goldenPixels << " pixels, the reference scan misses " << scanMissPixels << " marker pixels" << endl;
+  bool equivalent = true;
+  for(int engineCounter = 0; engineCounter < EQUIVALENCE_ENGINE_COUNT; engineCounter++)
+  {
+    if(!engineSelected[engineCounter])
+      continue;
+    const Equivalence_Result &result = results[engineCounter];
+    cout << equivalenceEngines[engineCounter].name << ": " << result.framesCompared << " frames, " << result.framesMismatching << " mismatching, ";
+    cout << result.missingPixels << " pixels missing, " << result.extraPixels << " pixels extra, " << result.scanMissPixels << " reference scan misses" << endl;
+    equivalent &= (result.framesMismatching == 0);
+  }
+  cout << (equivalent ? "EQUIVALENT" : "MISMATCH") << endl;
+  return equivalent ? 0 : 1;
+}
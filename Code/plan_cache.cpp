@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "plan_cache.hpp"
+
+using namespace std;
+
+#define PLAN_CACHE_MAGIC "PLANIDX"
+#define PLAN_CACHE_BYTE_ORDER 0x01020304u
+
+
+static uint64_t alignCacheOffset(uint64_t offset)
+{
+  return (offset + PLAN_CACHE_ALIGNMENT - 1) & ~(uint64_t) (PLAN_CACHE_ALIGNMENT - 1);
+}
+
+
+// Maps a whole file read only, an empty file gives an empty mapping
+static bool mapFile(const string &fileName, void *&mapping, size_t &size)
+{
+  int file = open(fileName.c_str(), O_RDONLY);
+  if(file < 0)
+    return false;
+  struct stat fileStat;
+  if(fstat(file, &fileStat) != 0)
+  {
+    close(file);
+    return false;
+  }
+  size = fileStat.st_size;
+  mapping = NULL;
+  if(size > 0)
+    mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if(mapping == MAP_FAILED)
+  {
+    mapping = NULL;
+    return false;
+  }
+  return true;
+}
+
+
+bool hashPlanFile(const string &fileName, uint64_t &sourceHash, uint64_t &sourceSize)
+{
+  void *mapping;
+  size_t size;
+  if(!mapFile(fileName, mapping, size))
+    return false;
+
+  const unsigned char *data = (const unsigned char *) mapping;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for(size_t byteCounter = 0; byteCounter < size; byteCounter++)
+    hash = (hash ^ data[byteCounter]) * 0x100000001b3ULL;
+  if(mapping)
+    munmap(mapping, size);
+  sourceHash = hash;
+  sourceSize = size;
+  return true;
+}
+
+
+static bool cacheSectionFits(const Plan_Cache_Header &header, uint64_t offset, uint64_t count, uint64_t elementSize)
+{
+  if(offset % PLAN_CACHE_ALIGNMENT != 0 || offset > header.fileSize)
+    return false;
+  return count <= (header.fileSize - offset) / elementSize;
+}
+
+
+bool openPlanCache(const string &cacheFileName, uint64_t sourceHash, uint64_t sourceSize, const Plan_Cache_Settings &settings, Plan_Cache &cache, Plan_Index *index)
+{
+  cache.mapping = NULL;
+  cache.mappingSize = 0;
+  void *mapping;
+  size_t size;
+  if(!mapFile(cacheFileName, mapping, size))
+    return false;
+  if(size < sizeof(Plan_Cache_Header))
+  {
+    if(mapping)
+      munmap(mapping, size);
+    return false;
+  }
+
+  const char *data = (const char *) mapping;
+  const Plan_Cache_Header &header = *(const Plan_Cache_Header *) data;
+  bool valid = (memcmp(header.magic, PLAN_CACHE_MAGIC, sizeof(header.magic)) == 0)
+    && (header.version == PLAN_CACHE_VERSION)
+    && (header.byteOrder == PLAN_CACHE_BYTE_ORDER)
+    && (header.sourceHash == sourceHash)
+    && (header.sourceSize == sourceSize)
+    && (memcmp(&header.settings, &settings, sizeof(settings)) == 0)
+    && (header.fileSize == size)
+    && (header.gpsPointCount <= 0x7fffffff)
+    && cacheSectionFits(header, header.gpsPointOffset, header.gpsPointCount, sizeof(GPS_Point))
+    && cacheSectionFits(header, header.markerOffset, header.markerCount, sizeof(Line_Marking_Points))
+    && cacheSectionFits(header, header.indexOffset, header.indexWordCount, sizeof(uint64_t));
+  if(valid && settings.buildIndex)
+  {
+    if(header.indexType == PLAN_INDEX_BITMAP)
+      valid = (header.latitudeCells * header.wordsPerRow == header.indexWordCount) && (header.wordsPerRow == (header.longitudeCells + 63) / 64);
+    else if(header.indexType == PLAN_INDEX_HASH)
+      valid = (header.slotMask + 1 == header.indexWordCount) && ((header.slotMask & (header.slotMask + 1)) == 0);
+    else
+      valid = (header.indexType == PLAN_INDEX_SORTED);
+  }
+  if(!valid)
+  {
+    munmap(mapping, size);
+    return false;
+  }
+
+  cache.mapping = mapping;
+  cache.mappingSize = size;
+  cache.gpsPoint = (const GPS_Point *) (data + header.gpsPointOffset);
+  cache.dataCounter = header.gpsPointCount;
+  cache.lineMark = (const Line_Marking_Points *) (data + header.markerOffset);
+  cache.markingSize = header.markerCount;
+  if(!settings.buildIndex || !index)
+    return true;
+
+  index->type = header.indexType;
+  index->sorted.lmp = cache.lineMark;
+  index->sorted.markingSize = cache.markingSize;
+  index->hash.slotStorage.clear();
+  index->hash.slots = NULL;
+  index->bitmap.bitStorage.clear();
+  index->bitmap.bits = NULL;
+  if(header.indexType == PLAN_INDEX_BITMAP)
+  {
+    index->bitmap.minLatitude = header.minLatitude;
+    index->bitmap.minLongitude = header.minLongitude;
+    index->bitmap.latitudeCells = header.latitudeCells;
+    index->bitmap.longitudeCells = header.longitudeCells;
+    index->bitmap.wordsPerRow = header.wordsPerRow;
+    index->bitmap.bits = (const uint64_t *) (data + header.indexOffset);
+  }
+  else if(header.indexType == PLAN_INDEX_HASH)
+  {
+    index->hash.slots = (const uint64_t *) (data + header.indexOffset);
+    index->hash.slotMask = header.slotMask;
+    index->hash.containsEmptyKey = header.containsEmptyKey;
+  }
+  return true;
+}
+
+
+static bool writeCacheSection(FILE *file, uint64_t &position, uint64_t offset, const void *data, size_t bytes)
+{
+  static const char padding[PLAN_CACHE_ALIGNMENT] = {0};
+  if(fwrite(padding, 1, offset - position, file) != offset - position)
+    return false;
+  if(bytes > 0 && fwrite(data, 1, bytes, file) != bytes)
+    return false;
+  position = offset + bytes;
+  return true;
+}
+
+
+bool writePlanCache(const string &cacheFileName, uint64_t sourceHash, uint64_t sourceSize, const Plan_Cache_Settings &settings, const GPS_Point *gpsPoint, int dataCounter, const Line_Marking_Points *lineMark, size_t markingSize, const Plan_Index *index)
+{
+  Plan_Cache_Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PLAN_CACHE_MAGIC, sizeof(header.magic));
+  header.version = PLAN_CACHE_VERSION;
+  header.byteOrder = PLAN_CACHE_BYTE_ORDER;
+  header.sourceHash = sourceHash;
+  header.sourceSize = sourceSize;
+  header.settings = settings;
+  header.indexType = -1;
+
+  for(size_t markCounter = 0; markCounter < markingSize; markCounter++)
+  {
+    const Line_Marking_Points &mark = lineMark[markCounter];
+    if(markCounter == 0 || mark.latitude < header.minLatitude)
+      header.minLatitude = mark.latitude;
+    if(markCounter == 0 || mark.longitude < header.minLongitude)
+      header.minLongitude = mark.longitude;
+    if(markCounter == 0 || mark.latitude > header.maxLatitude)
+      header.maxLatitude = mark.latitude;
+    if(markCounter == 0 || mark.longitude > header.maxLongitude)
+      header.maxLongitude = mark.longitude;
+  }
+
+  const uint64_t *indexWords = NULL;
+  if(settings.buildIndex && index)
+  {
+    header.indexType = index->type;
+    if(index->type == PLAN_INDEX_BITMAP)
+    {
+      header.latitudeCells = index->bitmap.latitudeCells;
+      header.longitudeCells = index->bitmap.longitudeCells;
+      header.wordsPerRow = index->bitmap.wordsPerRow;
+      header.indexWordCount = header.latitudeCells * header.wordsPerRow;
+      indexWords = index->bitmap.bits;
+    }
+    else if(index->type == PLAN_INDEX_HASH)
+    {
+      header.slotMask = index->hash.slotMask;
+      header.containsEmptyKey = index->hash.containsEmptyKey;
+      header.indexWordCount = header.slotMask + 1;
+      indexWords = index->hash.slots;
+    }
+  }
+
+  header.gpsPointCount = dataCounter;
+  header.gpsPointOffset = alignCacheOffset(sizeof(header));
+  header.markerCount = markingSize;
+  header.markerOffset = alignCacheOffset(header.gpsPointOffset + dataCounter * sizeof(GPS_Point));
+  header.indexOffset = alignCacheOffset(header.markerOffset + markingSize * sizeof(Line_Marking_Points));
+  header.fileSize = header.indexOffset + header.indexWordCount * sizeof(uint64_t);
+
+  string temporaryFileName = cacheFileName + ".tmp" + to_string(getpid());
+  FILE *file = fopen(temporaryFileName.c_str(), "wb");
+  if(!file)
+    return false;
+  uint64_t position = 0;
+  bool written = writeCacheSection(file, position, 0, &header, sizeof(header))
+    && writeCacheSection(file, position, header.gpsPointOffset, gpsPoint, dataCounter * sizeof(GPS_Point))
+    && writeCacheSection(file, position, header.markerOffset, lineMark, markingSize * sizeof(Line_Marking_Points))
+    && writeCacheSection(file, position, header.indexOffset, indexWords, header.indexWordCount * sizeof(uint64_t));
+  written = (fclose(file) == 0) && written;
+  if(!written || rename(temporaryFileName.c_str(), cacheFileName.c_str()) != 0)
+  {
+    remove(temporaryFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+void closePlanCache(Plan_Cache &cache)
+{
+  if(cache.mapping)
+    munmap(cache.mapping, cache.mappingSize);
+  cache.mapping = NULL;
+  cache.mappingSize = 0;
+}
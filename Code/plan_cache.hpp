@@ -0,0 +1,83 @@
+#ifndef PLAN_CACHE_HPP
+#define PLAN_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "plan_types.hpp"
+#include "plan_index.hpp"
+
+#define PLAN_CACHE_VERSION 1
+
+/*************************/
+/*** Binary plan cache ***/
+/*************************/
+// The finished plan, segments, ordered markers and the bitmap or hash set,
+// in one file next to the plan. Later runs map the file and use it in place.
+// The header carries a hash of the plan text and the build settings, a
+// cache that does not match both is rebuilt.
+//
+// Layout: Plan_Cache_Header, then the sections at the offsets in the
+// header, each aligned to PLAN_CACHE_ALIGNMENT.
+#define PLAN_CACHE_ALIGNMENT 64
+
+// Everything that changes the content of the cache besides the plan itself
+struct Plan_Cache_Settings {
+  uint32_t sortUnique;
+  uint32_t buildIndex;  // 0 = only segments and markers, reference lookup
+  uint64_t bitmapMaxBytes;
+  uint64_t hashMaxBytes;
+};
+
+struct Plan_Cache_Header {
+  char magic[8];  // "PLANIDX"
+  uint32_t version;
+  uint32_t byteOrder; // 0x01020304 as written by the host
+  uint64_t sourceHash;  // FNV-1a 64 of the plan file
+  uint64_t sourceSize;
+  Plan_Cache_Settings settings;
+  int32_t indexType;  // PLAN_INDEX_*, -1 without index
+  int32_t minLatitude;  // Bounding box of the markers in micro-degrees
+  int32_t minLongitude;
+  int32_t maxLatitude;
+  int32_t maxLongitude;
+  uint32_t containsEmptyKey;
+  uint64_t gpsPointCount;
+  uint64_t gpsPointOffset;
+  uint64_t markerCount;
+  uint64_t markerOffset;
+  uint64_t indexWordCount;  // Bitmap words or hash slots
+  uint64_t indexOffset;
+  uint64_t latitudeCells;
+  uint64_t longitudeCells;
+  uint64_t wordsPerRow;
+  uint64_t slotMask;
+  uint64_t fileSize;
+};
+
+// Mapping of an opened cache, the plan data points into it
+struct Plan_Cache {
+  void *mapping;
+  size_t mappingSize;
+  const GPS_Point *gpsPoint;
+  int dataCounter;
+  const Line_Marking_Points *lineMark;
+  size_t markingSize;
+};
+
+// Hash and size of the plan file, the key of the cache
+bool hashPlanFile(const std::string &fileName, uint64_t &sourceHash, uint64_t &sourceSize);
+
+// Maps the cache and fills cache and index if it belongs to the plan and the
+// settings. index may be NULL if settings.buildIndex is 0. Returns false if
+// the cache is missing, outdated or damaged, nothing is printed then.
+bool openPlanCache(const std::string &cacheFileName, uint64_t sourceHash, uint64_t sourceSize, const Plan_Cache_Settings &settings, Plan_Cache &cache, Plan_Index *index);
+
+// Writes into a temporary file first and renames it, a concurrent reader
+// never sees a half written cache
+bool writePlanCache(const std::string &cacheFileName, uint64_t sourceHash, uint64_t sourceSize, const Plan_Cache_Settings &settings, const GPS_Point *gpsPoint, int dataCounter, const Line_Marking_Points *lineMark, size_t markingSize, const Plan_Index *index);
+
+void closePlanCache(Plan_Cache &cache);
+
+#endif /* PLAN_CACHE_HPP */
@@ -0,0 +1,231 @@
+#include <iostream>
+#include <algorithm>
+
+#include "plan_index.hpp"
+
+using namespace std;
+
+// DEBUGGING
+#define DEBUG_LINE_MARKING 0
+
+
+bool lineMarkCompare(Line_Marking_Points lhs, Line_Marking_Points rhs)
+{
+  return lhs.latitude < rhs.latitude;
+}
+
+
+bool comparePositionToLineMark(int pixelPositionEast, int pixelPositionNorth, const Line_Marking_Points *lmp, int markingSize)
+{
+  int stepSizeIndexing = markingSize / 19;
+  #if DEBUG_LINE_MARKING
+    cout << "pixelPositionEast, pixelPositionNorth, lmp.lat, lmp.long, markingSize" << endl;
+    cout << pixelPositionEast << "; " << pixelPositionNorth << "; " << lmp[0].latitude << "; " << lmp[0].longitude << "; " << markingSize << endl;
+  #endif
+  // cout << "pixelPositionNorth: " << pixelPositionNorth << endl;
+  // cout << "lmp[221].latitude:  " << lmp[221].latitude << endl << endl;
+  // cout << "pixelPositionEast:  " << pixelPositionEast << endl;
+  // cout << "lmp[195].longitude: " << lmp[195].longitude << endl << endl;
+
+  for(int indexCounterLat = 0; indexCounterLat < markingSize; indexCounterLat += stepSizeIndexing)
+  {
+    if((pixelPositionNorth > lmp[indexCounterLat].latitude) & (pixelPositionNorth < lmp[(indexCounterLat + stepSizeIndexing)].latitude))
+    {
+      // approximate match for latitude
+      // cout << "appox match lat" << endl;
+      for(int lmpCounterLat = indexCounterLat; lmpCounterLat < (indexCounterLat + stepSizeIndexing); lmpCounterLat++)
+      {
+        if(pixelPositionNorth == lmp[lmpCounterLat].latitude)
+        {
+          // match for latitude
+          // cout << "match lat" << endl;
+          if(pixelPositionEast == lmp[lmpCounterLat].longitude)
+          {
+            // cout << "match lat" << endl;
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+
+void sortUniqueLineMarks(vector<Line_Marking_Points> &lineMarks)
+{
+  size_t markingSize = lineMarks.size();
+  vector<uint64_t> keys(markingSize);
+  vector<uint64_t> sortedKeys(markingSize);
+  vector<size_t> digitCounts(8 * 256, 0);
+  for(size_t markCounter = 0; markCounter < markingSize; markCounter++)
+  {
+    uint64_t key = orderedLineMarkKey(lineMarks[markCounter].latitude, lineMarks[markCounter].longitude);
+    keys[markCounter] = key;
+    for(int digit = 0; digit < 8; digit++)
+      digitCounts[digit * 256 + ((key >> (digit * 8)) & 0xFF)]++;
+  }
+
+  for(int digit = 0; digit < 8; digit++)
+  {
+    size_t *counts = &digitCounts[digit * 256];
+    if(markingSize == 0 || counts[(keys[0] >> (digit * 8)) & 0xFF] == markingSize)
+      continue; // Same digit everywhere, the pass would not move anything
+
+    size_t position = 0;
+    for(int value = 0; value < 256; value++)
+    {
+      size_t count = counts[value];
+      counts[value] = position;
+      position += count;
+    }
+    for(size_t markCounter = 0; markCounter < markingSize; markCounter++)
+    {
+      uint64_t key = keys[markCounter];
+      sortedKeys[counts[(key >> (digit * 8)) & 0xFF]++] = key;
+    }
+    keys.swap(sortedKeys);
+  }
+
+  size_t uniqueSize = unique(keys.begin(), keys.end()) - keys.begin();
+  lineMarks.resize(uniqueSize);
+  for(size_t markCounter = 0; markCounter < uniqueSize; markCounter++)
+  {
+    lineMarks[markCounter].latitude = (int) ((uint32_t) (keys[markCounter] >> 32) ^ 0x80000000u);
+    lineMarks[markCounter].longitude = (int) ((uint32_t) keys[markCounter] ^ 0x80000000u);
+  }
+}
+
+
+void buildPlanHashIndex(Plan_Hash_Index &index, const Line_Marking_Points *lmp, size_t markingSize)
+{
+  size_t slotCount = 16;
+  while(slotCount < 2 * markingSize)
+    slotCount <<= 1;
+
+  index.slotStorage.assign(slotCount, PLAN_HASH_EMPTY_KEY);
+  uint64_t *slots = index.slotStorage.data();
+  index.slots = slots;
+  index.slotMask = slotCount - 1;
+  index.containsEmptyKey = false;
+
+  for(size_t markCounter = 0; markCounter < markingSize; markCounter++)
+  {
+    uint64_t key = packLineMark(lmp[markCounter].latitude, lmp[markCounter].longitude);
+    if(key == PLAN_HASH_EMPTY_KEY)
+    {
+      index.containsEmptyKey = true;
+      continue;
+    }
+
+    uint64_t slot = hashLineMark(key) & index.slotMask;
+    while((slots[slot] != PLAN_HASH_EMPTY_KEY) && (slots[slot] != key))
+      slot = (slot + 1) & index.slotMask;
+    slots[slot] = key;  // duplicates of a marker end up in the same slot
+  }
+}
+
+
+bool buildPlanBitmapIndex(Plan_Bitmap_Index &index, const Line_Marking_Points *lmp, size_t markingSize, size_t maxBytes)
+{
+  index.minLatitude = 0;
+  index.minLongitude = 0;
+  index.latitudeCells = 0;
+  index.longitudeCells = 0;
+  index.wordsPerRow = 0;
+  index.bitStorage.clear();
+  index.bits = NULL;
+  if(markingSize == 0)
+    return true;
+
+  int maxLatitude = lmp[0].latitude;
+  int maxLongitude = lmp[0].longitude;
+  index.minLatitude = lmp[0].latitude;
+  index.minLongitude = lmp[0].longitude;
+  for(size_t markCounter = 1; markCounter < markingSize; markCounter++)
+  {
+    index.minLatitude = min(index.minLatitude, lmp[markCounter].latitude);
+    index.minLongitude = min(index.minLongitude, lmp[markCounter].longitude);
+    maxLatitude = max(maxLatitude, lmp[markCounter].latitude);
+    maxLongitude = max(maxLongitude, lmp[markCounter].longitude);
+  }
+
+  uint64_t latitudeCells = (uint64_t) ((int64_t) maxLatitude - index.minLatitude + 1);
+  uint64_t longitudeCells = (uint64_t) ((int64_t) maxLongitude - index.minLongitude + 1);
+  uint64_t wordsPerRow = (longitudeCells + 63) / 64;
+  if(latitudeCells * wordsPerRow * sizeof(uint64_t) > maxBytes)
+    return false;
+
+  index.latitudeCells = latitudeCells;
+  index.longitudeCells = longitudeCells;
+  index.wordsPerRow = wordsPerRow;
+  index.bitStorage.assign(latitudeCells * wordsPerRow, 0);
+  uint64_t *bits = index.bitStorage.data();
+  index.bits = bits;
+  for(size_t markCounter = 0; markCounter < markingSize; markCounter++)
+  {
+    uint32_t latitudeOffset = lmp[markCounter].latitude - index.minLatitude;
+    uint32_t longitudeOffset = lmp[markCounter].longitude - index.minLongitude;
+    bits[latitudeOffset * wordsPerRow + (longitudeOffset >> 6)] |= (uint64_t) 1 << (longitudeOffset & 63);
+  }
+  return true;
+}
+
+
+static bool latitudeLess(const Line_Marking_Points &lhs, const Line_Marking_Points &rhs)
+{
+  return lhs.latitude < rhs.latitude;
+}
+
+
+static bool longitudeLess(const Line_Marking_Points &lhs, const Line_Marking_Points &rhs)
+{
+  return lhs.longitude < rhs.longitude;
+}
+
+
+static bool lineMarkFullyLess(const Line_Marking_Points &lhs, const Line_Marking_Points &rhs)
+{
+  return (lhs.latitude < rhs.latitude) || ((lhs.latitude == rhs.latitude) && (lhs.longitude < rhs.longitude));
+}
+
+
+bool planSortedIndexContains(const Plan_Sorted_Index &index, int pixelPositionEast, int pixelPositionNorth)
+{
+  Line_Marking_Points position;
+  position.latitude = pixelPositionNorth;
+  position.longitude = pixelPositionEast;
+  const Line_Marking_Points *end = index.lmp + index.markingSize;
+  pair<const Line_Marking_Points *, const Line_Marking_Points *> latitudeRange = equal_range(index.lmp, end, position, latitudeLess);
+  const Line_Marking_Points *match = lower_bound(latitudeRange.first, latitudeRange.second, position, longitudeLess);
+  return (match != latitudeRange.second) && (match->longitude == pixelPositionEast);
+}
+
+
+void buildPlanIndex(Plan_Index &index, const Line_Marking_Points *lmp, size_t markingSize, size_t bitmapMaxBytes, size_t hashMaxBytes)
+{
+  index.sorted.lmp = lmp;
+  index.sorted.markingSize = markingSize;
+  if((bitmapMaxBytes > 0) && buildPlanBitmapIndex(index.bitmap, lmp, markingSize, bitmapMaxBytes))
+  {
+    index.type = PLAN_INDEX_BITMAP;
+    index.hash.slotStorage.clear();
+    index.hash.slots = NULL;
+    return;
+  }
+  index.bitmap.bitStorage.clear();
+  index.bitmap.bits = NULL;
+
+  size_t slotCount = 16;
+  while(slotCount < 2 * markingSize)
+    slotCount <<= 1;
+  if((slotCount * sizeof(uint64_t) > hashMaxBytes) && is_sorted(lmp, lmp + markingSize, lineMarkFullyLess))
+  {
+    index.type = PLAN_INDEX_SORTED;
+    index.hash.slotStorage.clear();
+    index.hash.slots = NULL;
+    return;
+  }
+  index.type = PLAN_INDEX_HASH;
+  buildPlanHashIndex(index.hash, lmp, markingSize);
+}
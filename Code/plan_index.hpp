@@ -0,0 +1,151 @@
+#ifndef PLAN_INDEX_HPP
+#define PLAN_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "plan_types.hpp"
+
+
+bool lineMarkCompare(Line_Marking_Points lhs, Line_Marking_Points rhs);
+
+// Key that orders markers by latitude, then longitude, also for negative
+// coordinates: the sign bits are flipped so unsigned order matches
+inline uint64_t orderedLineMarkKey(int latitude, int longitude)
+{
+  return ((uint64_t)((uint32_t) latitude ^ 0x80000000u) << 32) | ((uint32_t) longitude ^ 0x80000000u);
+}
+
+// LSD radix sort on orderedLineMarkKey, 8 bit digits, digits that are equal
+// for all markers are skipped. Duplicates are removed afterwards, the
+// markers end up fully ordered and unique.
+void sortUniqueLineMarks(std::vector<Line_Marking_Points> &lineMarks);
+
+// Reference lookup, linear scan over 19 latitude buckets of the sorted markers
+bool comparePositionToLineMark(int pixelPositionEast, int pixelPositionNorth, const Line_Marking_Points *lmp, int markingSize);
+
+
+/**************************************/
+/*** Hash set index of line markers ***/
+/**************************************/
+// Open addressing with linear probing, every slot holds a packed
+// (latitude, longitude) micro-degree pair. The load factor is kept below 0.5
+// so a probe sequence always ends at an empty slot.
+#define PLAN_HASH_EMPTY_KEY 0xFFFFFFFFFFFFFFFFULL
+
+// slots points into slotStorage, or into a mapped plan cache
+struct Plan_Hash_Index {
+  std::vector<uint64_t> slotStorage;
+  const uint64_t *slots;
+  uint64_t slotMask;
+  bool containsEmptyKey;  // the one key that collides with the empty marker
+};
+
+inline uint64_t packLineMark(int latitude, int longitude)
+{
+  return ((uint64_t)(uint32_t) latitude << 32) | (uint32_t) longitude;
+}
+
+inline uint64_t hashLineMark(uint64_t key)
+{
+  // Finalizer of MurmurHash3, spreads neighbouring micro-degrees over the table
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return key;
+}
+
+void buildPlanHashIndex(Plan_Hash_Index &index, const Line_Marking_Points *lmp, size_t markingSize);
+
+inline bool planHashIndexContains(const Plan_Hash_Index &index, int pixelPositionEast, int pixelPositionNorth)
+{
+  uint64_t key = packLineMark(pixelPositionNorth, pixelPositionEast);
+  if(key == PLAN_HASH_EMPTY_KEY)
+    return index.containsEmptyKey;
+
+  for(uint64_t slot = hashLineMark(key) & index.slotMask; ; slot = (slot + 1) & index.slotMask)
+  {
+    if(index.slots[slot] == key)
+      return true;
+    if(index.slots[slot] == PLAN_HASH_EMPTY_KEY)
+      return false;
+  }
+}
+
+
+
+/**********************************************/
+/*** Bitmap raster of the plan bounding box ***/
+/**********************************************/
+// One bit per micro-degree cell, rows are latitudes and are padded to whole
+// 64 bit words. Small plans only need a few KB and stay in L1/L2.
+struct Plan_Bitmap_Index {
+  int minLatitude;
+  int minLongitude;
+  uint32_t latitudeCells;
+  uint32_t longitudeCells;
+  size_t wordsPerRow;
+  std::vector<uint64_t> bitStorage;
+  const uint64_t *bits; // latitudeCells * wordsPerRow words, in bitStorage or a mapped plan cache
+};
+
+// Returns false without building if the bitmap would exceed maxBytes
+bool buildPlanBitmapIndex(Plan_Bitmap_Index &index, const Line_Marking_Points *lmp, size_t markingSize, size_t maxBytes);
+
+inline bool planBitmapIndexContains(const Plan_Bitmap_Index &index, int pixelPositionEast, int pixelPositionNorth)
+{
+  // Unsigned wrap-around turns positions below the minimum into huge offsets
+  uint32_t latitudeOffset = (uint32_t) pixelPositionNorth - (uint32_t) index.minLatitude;
+  uint32_t longitudeOffset = (uint32_t) pixelPositionEast - (uint32_t) index.minLongitude;
+  if((latitudeOffset >= index.latitudeCells) | (longitudeOffset >= index.longitudeCells))
+    return false;
+  return (index.bits[latitudeOffset * index.wordsPerRow + (longitudeOffset >> 6)] >> (longitudeOffset & 63)) & 1;
+}
+
+
+/************************************************/
+/*** Binary search on the fully ordered array ***/
+/************************************************/
+// No memory of its own, the markers have to be ordered by latitude and then
+// longitude, see sortUniqueLineMarks. equal_range finds the markers of the
+// latitude, a second binary search the longitude in there.
+struct Plan_Sorted_Index {
+  const Line_Marking_Points *lmp;
+  size_t markingSize;
+};
+
+bool planSortedIndexContains(const Plan_Sorted_Index &index, int pixelPositionEast, int pixelPositionNorth);
+
+
+/***************************************************/
+/*** Plan index, bitmap, hash set or sorted array ***/
+/***************************************************/
+#define PLAN_INDEX_HASH 0
+#define PLAN_INDEX_BITMAP 1
+#define PLAN_INDEX_SORTED 2
+
+struct Plan_Index {
+  int type;
+  Plan_Hash_Index hash;
+  Plan_Bitmap_Index bitmap;
+  Plan_Sorted_Index sorted;
+};
+
+// Uses the bitmap if it fits into bitmapMaxBytes, then the hash set if it
+// fits into hashMaxBytes, the sorted array otherwise. A bitmapMaxBytes of 0
+// skips the bitmap. Markers that are not fully ordered always get the hash
+// set. The sorted index points into lmp, which has to outlive the index.
+// The index points into its own storage, it must not be copied.
+void buildPlanIndex(Plan_Index &index, const Line_Marking_Points *lmp, size_t markingSize, size_t bitmapMaxBytes, size_t hashMaxBytes);
+
+inline bool planIndexContains(const Plan_Index &index, int pixelPositionEast, int pixelPositionNorth)
+{
+  if(index.type == PLAN_INDEX_BITMAP)
+    return planBitmapIndexContains(index.bitmap, pixelPositionEast, pixelPositionNorth);
+  if(index.type == PLAN_INDEX_SORTED)
+    return planSortedIndexContains(index.sorted, pixelPositionEast, pixelPositionNorth);
+  return planHashIndexContains(index.hash, pixelPositionEast, pixelPositionNorth);
+}
+
+#endif /* PLAN_INDEX_HPP */
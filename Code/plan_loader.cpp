@@ -0,0 +1,130 @@
+#include <charconv>
+#include <iostream>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "plan_loader.hpp"
+
+using namespace std;
+
+
+// Parses "<lat>/<lon>" up to the end of the line
+static bool parseCoordinates(const char *begin, const char *end, double &latitude, double &longitude, const char *&error)
+{
+  while(begin < end && (*begin == ' ' || *begin == '\t'))
+    begin++;
+  from_chars_result result = from_chars(begin, end, latitude);
+  if(result.ec != errc() || result.ptr == begin)
+  {
+    error = "invalid latitude";
+    return false;
+  }
+  if(result.ptr - begin < PLAN_MIN_COORDINATE_CHARS)
+  {
+    error = "latitude has to few digits";
+    return false;
+  }
+  if(result.ptr >= end || *result.ptr != '/')
+  {
+    error = "expected / between latitude and longitude";
+    return false;
+  }
+
+  begin = result.ptr + 1;
+  while(begin < end && (*begin == ' ' || *begin == '\t'))
+    begin++;
+  result = from_chars(begin, end, longitude);
+  if(result.ec != errc() || result.ptr == begin)
+  {
+    error = "invalid longitude";
+    return false;
+  }
+  if(result.ptr - begin < PLAN_MIN_COORDINATE_CHARS)
+  {
+    error = "longitude has to few digits";
+    return false;
+  }
+  return true;
+}
+
+
+static bool parsePlan(const string &fileName, const char *data, size_t size, vector<GPS_Point> &gpsPoints)
+{
+  gpsPoints.clear();
+  gpsPoints.reserve(size / 44 + 1);  // Two lines of about 22 characters per segment
+
+  GPS_Point gpsPoint;
+  memset(&gpsPoint, 0, sizeof(gpsPoint));
+  const char *end = data + size;
+  int lineNumber = 1;
+  for(const char *line = data; line < end; lineNumber++)
+  {
+    const char *lineEnd = (const char *) memchr(line, '\n', end - line);
+    if(!lineEnd)
+      lineEnd = end;
+    const char *next = lineEnd + 1;
+    while(lineEnd > line && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+      lineEnd--;
+
+    if(lineEnd - line >= 2 && line[1] == ':' && (line[0] == 'S' || line[0] == 'E'))
+    {
+      const char *error = NULL;
+      bool parsed;
+      if(line[0] == 'S')
+        parsed = parseCoordinates(line + 2, lineEnd, gpsPoint.startLatitude, gpsPoint.startLongitude, error);
+      else
+        parsed = parseCoordinates(line + 2, lineEnd, gpsPoint.endLatitude, gpsPoint.endLongitude, error);
+      if(!parsed)
+      {
+        cout << fileName << ":" << lineNumber << ": Error processing " << ((line[0] == 'S') ? "starting" : "ending") << " point of " << gpsPoints.size() << ". GPS Line, " << error << endl;
+        return false;
+      }
+      if(line[0] == 'E')
+        gpsPoints.push_back(gpsPoint);
+    }
+    line = next;
+  }
+  return true;
+}
+
+
+bool loadPlanFile(const string &fileName, vector<GPS_Point> &gpsPoints)
+{
+  int planFile = open(fileName.c_str(), O_RDONLY);
+  if(planFile < 0)
+  {
+    cout << "Could not open plan file!" << endl;
+    return false;
+  }
+  struct stat planStat;
+  if(fstat(planFile, &planStat) != 0)
+  {
+    cout << "Could not read plan file!" << endl;
+    close(planFile);
+    return false;
+  }
+
+  size_t size = planStat.st_size;
+  if(size == 0)
+  {
+    close(planFile);
+    gpsPoints.clear();
+    return true;
+  }
+
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, planFile, 0);
+  close(planFile);  // The mapping stays valid
+  if(data == MAP_FAILED)
+  {
+    cout << "Could not map plan file!" << endl;
+    return false;
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  bool parsed = parsePlan(fileName, (const char *) data, size, gpsPoints);
+  munmap(data, size);
+  return parsed;
+}
@@ -0,0 +1,20 @@
+#ifndef PLAN_LOADER_HPP
+#define PLAN_LOADER_HPP
+
+#include <string>
+#include <vector>
+
+#include "plan_types.hpp"
+
+#define PLAN_MIN_COORDINATE_CHARS 9 // e.g. 48.378986, fewer digits are too coarse for micro-degrees
+
+/*******************/
+/*** Plan loader ***/
+/*******************/
+// Reads a plan file with "S:<lat>/<lon>" start and "E:<lat>/<lon>" end
+// lines, other lines are ignored. The file is memory mapped and parsed in
+// place with std::from_chars, no strings are built per line. Returns false
+// and prints the line number on errors.
+bool loadPlanFile(const std::string &fileName, std::vector<GPS_Point> &gpsPoints);
+
+#endif /* PLAN_LOADER_HPP */
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <math.h>
+
+#include <opencv2/core.hpp>
+
+#include "plan_raster.hpp"
+
+using namespace std;
+using namespace cv;
+
+
+static int segmentSteps(const GPS_Point &gpsPoint)
+{
+  double deltaLatitude = gpsPoint.endLatitude - gpsPoint.startLatitude;
+  double deltaLongitude = gpsPoint.endLongitude - gpsPoint.startLongitude;
+  int steps;
+  if (fabs(deltaLatitude) > fabs(deltaLongitude))
+    steps = fabs(deltaLatitude) * 1000000;
+  else
+    steps = fabs(deltaLongitude) * 1000000;
+  return steps + 1;
+}
+
+
+// Markers firstStep up to lastStep (exclusive) of one segment
+static void fillSegment(const GPS_Point &gpsPoint, int steps, int firstStep, int lastStep, Line_Marking_Points *lineMark)
+{
+  double deltaLatitude = gpsPoint.endLatitude - gpsPoint.startLatitude;
+  double deltaLongitude = gpsPoint.endLongitude - gpsPoint.startLongitude;
+  if(steps == 1)
+  {
+    // Shorter than a micro-degree, only the starting point
+    lineMark[0].latitude = gpsPoint.startLatitude * 1000000;
+    lineMark[0].longitude = gpsPoint.startLongitude * 1000000;
+    return;
+  }
+  for(int stepCounter = firstStep; stepCounter < lastStep; stepCounter++)
+  {
+    lineMark[stepCounter - firstStep].latitude = (gpsPoint.startLatitude + (long double) stepCounter * (deltaLatitude / (long double) (steps - 1))) * 1000000;
+    lineMark[stepCounter - firstStep].longitude = (gpsPoint.startLongitude + (double) stepCounter * (deltaLongitude / (double) (steps - 1))) * 1000000;
+  }
+}
+
+
+void rasterizePlan(const GPS_Point *gpsPoint, int dataCounter, vector<Line_Marking_Points> &lineMarks)
+{
+  // Output range of every segment
+  vector<size_t> segmentStart(dataCounter + 1);
+  segmentStart[0] = 0;
+  for(int lineCounter = 0; lineCounter < dataCounter; lineCounter++)
+    segmentStart[lineCounter + 1] = segmentStart[lineCounter] + segmentSteps(gpsPoint[lineCounter]);
+  size_t markingSize = segmentStart[dataCounter];
+  lineMarks.resize(markingSize);
+  if(markingSize == 0)
+    return;
+
+  // Equal chunks of markers, a long segment is split over several chunks
+  int chunkCount = (markingSize + RASTER_CHUNK_MARKERS - 1) / RASTER_CHUNK_MARKERS;
+  Line_Marking_Points *lineMark = lineMarks.data();
+  parallel_for_(Range(0, chunkCount), [&](const Range &range)
+  {
+    for(int chunkCounter = range.start; chunkCounter < range.end; chunkCounter++)
+    {
+      size_t chunkBegin = (size_t) chunkCounter * RASTER_CHUNK_MARKERS;
+      size_t chunkEnd = min(chunkBegin + RASTER_CHUNK_MARKERS, markingSize);
+      int lineCounter = upper_bound(segmentStart.begin(), segmentStart.end(), chunkBegin) - segmentStart.begin() - 1;
+      for(size_t position = chunkBegin; position < chunkEnd; lineCounter++)
+      {
+        int steps = segmentStart[lineCounter + 1] - segmentStart[lineCounter];
+        int firstStep = position - segmentStart[lineCounter];
+        int lastStep = min(segmentStart[lineCounter + 1], chunkEnd) - segmentStart[lineCounter];
+        fillSegment(gpsPoint[lineCounter], steps, firstStep, lastStep, lineMark + position);
+        position += lastStep - firstStep;
+      }
+    }
+  });
+}
@@ -0,0 +1,19 @@
+#ifndef PLAN_RASTER_HPP
+#define PLAN_RASTER_HPP
+
+#include <vector>
+
+#include "plan_types.hpp"
+
+#define RASTER_CHUNK_MARKERS 65536  // Markers per parallel work item
+
+/*************************************/
+/*** Rasterization of plan markers ***/
+/*************************************/
+// Every segment becomes one marker per micro-degree along its longer axis,
+// both end points included. The step counts of all segments are summed
+// first, so the markers are allocated once and each segment knows its
+// output range. The markers are filled in chunks over cv::parallel_for_.
+void rasterizePlan(const GPS_Point *gpsPoint, int dataCounter, std::vector<Line_Marking_Points> &lineMarks);
+
+#endif /* PLAN_RASTER_HPP */
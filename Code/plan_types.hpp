@@ -0,0 +1,16 @@
+#ifndef PLAN_TYPES_HPP
+#define PLAN_TYPES_HPP
+
+struct GPS_Point {
+  double startLatitude;
+  double startLongitude;
+  double endLatitude;
+  double endLongitude;
+};
+
+struct Line_Marking_Points {
+  /*long double*/int latitude;
+  /*long double*/int longitude;
+};
+
+#endif /* PLAN_TYPES_HPP */
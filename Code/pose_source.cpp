@@ -0,0 +1,17 @@
+#include "pose_source.hpp"
+
+
+void poseOfFrame(const Pose_Source &source, int frameCounter, double timestamp, Camera_Pose &pose)
+{
+  if(source.track)
+  {
+    double trackTime = source.track->samples.front().time + source.trackOffset + timestamp / 1000;
+    trackPoseAt(*source.track, trackTime, source.trackInterpolation, source.tilt, pose);
+    return;
+  }
+
+  pose.latitude = source.latitudeStart +  ((source.latitudeEnd - source.latitudeStart) / source.pathFrames) * frameCounter;
+  pose.longitude = source.longitudeStart +  ((source.longitudeEnd - source.longitudeStart) / source.pathFrames) * frameCounter;
+  pose.direction = source.direction;
+  pose.tilt = source.tilt;
+}
@@ -0,0 +1,30 @@
+#ifndef POSE_SOURCE_HPP
+#define POSE_SOURCE_HPP
+
+#include "camera_projection.hpp"
+#include "gps_track.hpp"
+
+/*******************/
+/*** Pose source ***/
+/*******************/
+// Gives the camera pose of any frame from its index and timestamp alone, so
+// nothing is stored per frame and the video length does not need to be
+// known in advance. Poses come from a GPS track or, without one, from a
+// straight path walked in pathFrames frames.
+struct Pose_Source {
+  const GPS_Track *track; // NULL = straight path
+  double trackOffset; // Seconds from the first track sample to the first video frame
+  int trackInterpolation;
+  long double latitudeStart;
+  long double longitudeStart;
+  long double latitudeEnd;
+  long double longitudeEnd;
+  double pathFrames;  // Frames from the start to the end of the straight path
+  double direction;
+  double tilt;
+};
+
+// frameCounter counts from the first frame of the video, timestamp is in ms
+void poseOfFrame(const Pose_Source &source, int frameCounter, double timestamp, Camera_Pose &pose);
+
+#endif /* POSE_SOURCE_HPP */
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <math.h>
+
+#include "projection_math.hpp"
+
+using namespace std;
+
+
+static void resetPrecisionDeviation(Precision_Deviation &deviation)
+{
+  deviation.maxSolution1 = 0;
+  deviation.maxSolution2 = 0;
+  deviation.truncationMismatches = 0;
+}
+
+
+void initPrecisionReport(Precision_Report &report, double tilt, int frameWidth, int frameHeight)
+{
+  buildCameraGeometry(report.geometryFloat, tilt, frameWidth, frameHeight);
+  buildCameraGeometry(report.geometryDouble, tilt, frameWidth, frameHeight);
+  buildCameraGeometry(report.geometryLongDouble, tilt, frameWidth, frameHeight);
+  resetPrecisionDeviation(report.deviationFloat);
+  resetPrecisionDeviation(report.deviationDouble);
+  report.pixelCount = 0;
+  report.frameCount = 0;
+}
+
+
+// Compares one pixel of both solutions in Real against the long double reference
+template<typename Real>
+static void comparePixelPrecision(Precision_Deviation &deviation, const Camera_Geometry<Real> &geometry, const Projection_Pose<Real> &pose, const Solution_2_Row<Real> &projection,
+                                  long double referenceEast1, long double referenceNorth1, long double referenceEast2, long double referenceNorth2, int row, int column)
+{
+  Real positionEast;
+  Real positionNorth;
+  projectPixelSolution1(geometry, pose, row, column, positionEast, positionNorth);
+  deviation.maxSolution1 = max(deviation.maxSolution1, fabsl(positionEast - referenceEast1) * 1000000);
+  deviation.maxSolution1 = max(deviation.maxSolution1, fabsl(positionNorth - referenceNorth1) * 1000000);
+
+  positionEast = columnPositionSolution2(projection.longitudeLeftPoint, projection.steppingWidthEast, column);
+  positionNorth = columnPositionSolution2(projection.latitudeLeftPoint, projection.steppingWidthNorth, column);
+  deviation.maxSolution2 = max(deviation.maxSolution2, fabsl(positionEast - referenceEast2) * 1000000);
+  deviation.maxSolution2 = max(deviation.maxSolution2, fabsl(positionNorth - referenceNorth2) * 1000000);
+  if(((int)(positionEast * 1000000) != (int)(referenceEast2 * 1000000)) | ((int)(positionNorth * 1000000) != (int)(referenceNorth2 * 1000000)))
+    deviation.truncationMismatches++;
+}
+
+
+void updatePrecisionReport(Precision_Report &report, long double latitude, long double longitude, double direction)
+{
+  Projection_Pose<float> poseFloat;
+  Projection_Pose<double> poseDouble;
+  Projection_Pose<long double> poseLongDouble;
+  buildProjectionPose(poseFloat, latitude, longitude, direction);
+  buildProjectionPose(poseDouble, latitude, longitude, direction);
+  buildProjectionPose(poseLongDouble, latitude, longitude, direction);
+
+  const Camera_Geometry<long double> &geometry = report.geometryLongDouble;
+  for (int row = 1; row <= geometry.rowCount; row++)
+  {
+    Solution_2_Row<float> projectionFloat;
+    Solution_2_Row<double> projectionDouble;
+    Solution_2_Row<long double> projectionLongDouble;
+    projectRowSolution2(report.geometryFloat, poseFloat, row, projectionFloat);
+    projectRowSolution2(report.geometryDouble, poseDouble, row, projectionDouble);
+    projectRowSolution2(geometry, poseLongDouble, row, projectionLongDouble);
+
+    for (int column = 1; column <= geometry.frameWidth; column++)
+    {
+      long double referenceEast1;
+      long double referenceNorth1;
+      projectPixelSolution1(geometry, poseLongDouble, row, column, referenceEast1, referenceNorth1);
+      long double referenceEast2 = columnPositionSolution2(projectionLongDouble.longitudeLeftPoint, projectionLongDouble.steppingWidthEast, column);
+      long double referenceNorth2 = columnPositionSolution2(projectionLongDouble.latitudeLeftPoint, projectionLongDouble.steppingWidthNorth, column);
+
+      comparePixelPrecision(report.deviationFloat, report.geometryFloat, poseFloat, projectionFloat, referenceEast1, referenceNorth1, referenceEast2, referenceNorth2, row, column);
+      comparePixelPrecision(report.deviationDouble, report.geometryDouble, poseDouble, projectionDouble, referenceEast1, referenceNorth1, referenceEast2, referenceNorth2, row, column);
+      report.pixelCount++;
+    }
+  }
+  report.frameCount++;
+}
+
+
+void printPrecisionReport(const Precision_Report &report)
+{
+  cout << "*** Precision report, deviation from long double ***" << endl;
+  cout << "Frames: " << report.frameCount << ", pixels: " << report.pixelCount << endl;
+  cout << "precision;maxSolution1 [micro-degree];maxSolution2 [micro-degree];truncationMismatches" << endl;
+  cout << "float;" << report.deviationFloat.maxSolution1 << ";" << report.deviationFloat.maxSolution2 << ";" << report.deviationFloat.truncationMismatches << endl;
+  cout << "double;" << report.deviationDouble.maxSolution1 << ";" << report.deviationDouble.maxSolution2 << ";" << report.deviationDouble.truncationMismatches << endl;
+}
@@ -0,0 +1,208 @@
+#ifndef PROJECTION_MATH_HPP
+#define PROJECTION_MATH_HPP
+
+#include <math.h>
+#include <vector>
+
+#include "camera_projection.hpp"
+
+/*********************************************/
+/*** Precision policy of SOLUTION_1 and _2 ***/
+/*********************************************/
+// The projection math is templated on its floating point type. The frame
+// loop uses Projection_Real, selected at build time with
+// -DPROJECTION_PRECISION=0 (float), 1 (double) or 2 (long double, reference).
+// long double is x87 code on x86-64 and cannot be vectorized, double keeps
+// the positions within a fraction of a micro-degree, see the precision report.
+#define PROJECTION_FLOAT 0
+#define PROJECTION_DOUBLE 1
+#define PROJECTION_LONG_DOUBLE 2
+
+#ifndef PROJECTION_PRECISION
+  #define PROJECTION_PRECISION PROJECTION_LONG_DOUBLE
+#endif
+
+#if PROJECTION_PRECISION == PROJECTION_FLOAT
+  typedef float Projection_Real;
+#elif PROJECTION_PRECISION == PROJECTION_DOUBLE
+  typedef double Projection_Real;
+#else
+  typedef long double Projection_Real;
+#endif
+
+
+/********************************/
+/*** Frame invariant geometry ***/
+/********************************/
+// Everything of SOLUTION_1 and SOLUTION_2 that only depends on the camera
+// mounting and the frame size, built once after the video is opened.
+// Rows and columns are counted from 1 as in the frame loop, the tables are
+// indexed with row - 1 and column - 1. The tables are always computed in
+// long double and stored as Real.
+template<typename Real>
+struct Camera_Geometry {
+  int frameWidth;
+  int frameHeight;
+  int rowCount; // Rows above exceed MAX_BASELINE_ANGLE
+  std::vector<Real> distanceOfBaseline;
+  std::vector<Real> distanceOfSideline;  // SOLUTION_2, half width of the row at AOV_H / 2
+  std::vector<Real> sidelineTangent; // SOLUTION_1, tan of the sideline angle of each column
+};
+
+template<typename Real>
+void buildCameraGeometry(Camera_Geometry<Real> &geometry, double tilt, int frameWidth, int frameHeight)
+{
+  geometry.frameWidth = frameWidth;
+  geometry.frameHeight = frameHeight;
+  geometry.distanceOfBaseline.clear();
+  geometry.distanceOfSideline.clear();
+  for(int row = 1; row <= frameHeight; row++)
+  {
+    long double baselinePixelAngle = baselineAngleOfRow(row, tilt, frameHeight);
+    if(baselinePixelAngle > MAX_BASELINE_ANGLE)
+      break;
+    long double distanceOfBaseline = tan(degreeToRadiant(baselinePixelAngle)) * (long double) HEIGHT;
+    geometry.distanceOfBaseline.push_back((Real) distanceOfBaseline);
+    geometry.distanceOfSideline.push_back((Real) (tan(degreeToRadiant((long double) AOV_H / 2)) * distanceOfBaseline));
+  }
+  geometry.rowCount = geometry.distanceOfBaseline.size();
+
+  long double halfFrameWidth = (double) frameWidth / 2;
+  geometry.sidelineTangent.resize(frameWidth);
+  for(int column = 1; column <= frameWidth; column++)
+  {
+    long double sidelinePixelAngle;
+    if (column < (halfFrameWidth + 1))  // Left image side
+      sidelinePixelAngle = ((long double) AOV_H / 2) * (halfFrameWidth - (column - 1)) / halfFrameWidth;
+    else  // Right image side
+      sidelinePixelAngle = ((long double) AOV_H / 2) * ((column - 1) - halfFrameWidth) / halfFrameWidth;
+    geometry.sidelineTangent[column - 1] = (Real) tan(degreeToRadiant(sidelinePixelAngle));
+  }
+}
+
+
+/*****************************/
+/*** Per frame camera pose ***/
+/*****************************/
+template<typename Real>
+struct Projection_Pose {
+  Real latitude;
+  Real longitude;
+  Real sinDirection;
+  Real cosDirection;
+};
+
+template<typename Real>
+inline void buildProjectionPose(Projection_Pose<Real> &pose, long double latitude, long double longitude, double direction)
+{
+  Real directionRadiant = (Real) direction * (Real) PI / 180;
+  pose.latitude = (Real) latitude;
+  pose.longitude = (Real) longitude;
+  pose.sinDirection = sin(directionRadiant);
+  pose.cosDirection = cos(directionRadiant);
+}
+
+
+/*****************************************/
+/*** Solution 1, position of one pixel ***/
+/*****************************************/
+// Position in degrees
+template<typename Real>
+inline void projectPixelSolution1(const Camera_Geometry<Real> &geometry, const Projection_Pose<Real> &pose, int row, int column, Real &positionEast, Real &positionNorth)
+{
+  Real distanceOfBaseline = geometry.distanceOfBaseline[row - 1];
+  Real distanceOfSideline = geometry.sidelineTangent[column - 1] * distanceOfBaseline;
+  Real distanceOfSidelineEast;
+  Real distanceOfSidelineNorth;
+  if (2 * (column - 1) < geometry.frameWidth)  // Left image side
+  {
+    distanceOfSidelineEast = - pose.cosDirection * distanceOfSideline;
+    distanceOfSidelineNorth = pose.sinDirection * distanceOfSideline;
+  }
+  else  // Right image side
+  {
+    distanceOfSidelineEast = pose.cosDirection * distanceOfSideline;
+    distanceOfSidelineNorth = - pose.sinDirection * distanceOfSideline;
+  }
+
+  Real pixelDistanceEast = pose.sinDirection * distanceOfBaseline + distanceOfSidelineEast;
+  Real pixelDistanceNorth = pose.cosDirection * distanceOfBaseline + distanceOfSidelineNorth;
+
+  positionEast = pose.longitude + ((pixelDistanceEast / 1000000) / (Real) 111.32);
+  positionNorth = pose.latitude + ((pixelDistanceNorth / 1000000) / (Real) 111.32);
+}
+
+
+/*************************************************/
+/*** Solution 2, left and right point of a row ***/
+/*************************************************/
+template<typename Real>
+struct Solution_2_Row {
+  Real longitudeLeftPoint;
+  Real latitudeLeftPoint;
+  Real longitudeRightPoint;
+  Real latitudeRightPoint;
+  Real steppingWidthEast;
+  Real steppingWidthNorth;
+};
+
+template<typename Real>
+inline void projectRowSolution2(const Camera_Geometry<Real> &geometry, const Projection_Pose<Real> &pose, int row, Solution_2_Row<Real> &projection)
+{
+  Real distanceOfBaseline = geometry.distanceOfBaseline[row - 1];
+  Real distanceOfBaselineCenterEastGPS = ((pose.sinDirection * distanceOfBaseline) / 1000000) / (Real) 111.32;
+  Real distanceOfBaselineCenterNorthGPS = ((pose.cosDirection * distanceOfBaseline) / 1000000) / (Real) 111.32;
+
+  Real distanceOfSideline = geometry.distanceOfSideline[row - 1];
+  // Left point of view
+  Real distanceOfSidelineEastGPS = ((- pose.cosDirection * distanceOfSideline) / 1000000) / (Real) 111.32;
+  Real distanceOfSidelineNorthGPS = ((pose.sinDirection * distanceOfSideline) / 1000000) / (Real) 111.32;
+  projection.longitudeLeftPoint = pose.longitude + distanceOfBaselineCenterEastGPS + distanceOfSidelineEastGPS;
+  projection.latitudeLeftPoint = pose.latitude + distanceOfBaselineCenterNorthGPS + distanceOfSidelineNorthGPS;
+
+  // Right point of view
+  distanceOfSidelineEastGPS = ((pose.cosDirection * distanceOfSideline) / 1000000) / (Real) 111.32;
+  distanceOfSidelineNorthGPS = ((- pose.sinDirection * distanceOfSideline) / 1000000) / (Real) 111.32;
+  projection.longitudeRightPoint = pose.longitude + distanceOfBaselineCenterEastGPS + distanceOfSidelineEastGPS;
+  projection.latitudeRightPoint = pose.latitude + distanceOfBaselineCenterNorthGPS + distanceOfSidelineNorthGPS;
+
+  projection.steppingWidthEast = (projection.longitudeRightPoint - projection.longitudeLeftPoint) / (Real) geometry.frameWidth;
+  projection.steppingWidthNorth = (projection.latitudeRightPoint - projection.latitudeLeftPoint) / (Real) geometry.frameWidth;
+}
+
+// Position of a column in degrees, the frame loop truncates it to micro-degrees
+template<typename Real>
+inline Real columnPositionSolution2(Real leftPoint, Real steppingWidth, int column)
+{
+  return leftPoint + column * steppingWidth;
+}
+
+
+/************************/
+/*** Precision report ***/
+/************************/
+// Runs both solutions in float and double next to the long double
+// reference and records the largest deviation of the pixel positions in
+// micro-degrees, plus how many SOLUTION_2 positions truncate to a different
+// integer micro-degree.
+struct Precision_Deviation {
+  long double maxSolution1;
+  long double maxSolution2;
+  long long truncationMismatches;
+};
+
+struct Precision_Report {
+  Camera_Geometry<float> geometryFloat;
+  Camera_Geometry<double> geometryDouble;
+  Camera_Geometry<long double> geometryLongDouble;
+  Precision_Deviation deviationFloat;
+  Precision_Deviation deviationDouble;
+  long long pixelCount;
+  int frameCount;
+};
+
+void initPrecisionReport(Precision_Report &report, double tilt, int frameWidth, int frameHeight);
+void updatePrecisionReport(Precision_Report &report, long double latitude, long double longitude, double direction);
+void printPrecisionReport(const Precision_Report &report);
+
+#endif /* PROJECTION_MATH_HPP */
@@ -1,197 +1,169 @@
 #include <iostream>
-#include <fstream>
 #include <math.h>
 
 #include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "plan_types.hpp"
+#include "plan_index.hpp"
+#include "plan_loader.hpp"
+#include "plan_raster.hpp"
+#include "plan_cache.hpp"
+#include "camera_projection.hpp"
+#include "projection_math.hpp"
+#include "column_kernel.hpp"
+#include "frame_overlay.hpp"
+#include "frame_pipeline.hpp"
+#include "run_options.hpp"
+#include "frame_writer.hpp"
+#include "video_merge.hpp"
+#include "gps_track.hpp"
+#include "pose_source.hpp"
+#include "stage_timing.hpp"
+#include "mask_stream.hpp"
+
 using namespace std;
 using namespace cv;
 
-#define AOV_V 31  // AngleOfView_Veritically
-#define AOV_H 67  // AngleOfView_Horizontally
-#define HEIGHT 1400 // Measurement in mm, height over ground in wich video was captured
-#define PI 3.14159265
-
 #define SOLUTION_1 0
 #define SOLUTION_2 1
+#define SOLUTION_3 0  // Forward projection of the plan segments
+#define SOLUTION_4 0  // Ground homography of the SOLUTION_2 corner points
+
+// Plan lookup, all 0 = reference scan comparePositionToLineMark
+#define PLAN_LOOKUP_HASH 0
+#define PLAN_LOOKUP_BITMAP 1  // Falls back to the hash set if the bitmap gets too large
+#define PLAN_BITMAP_MAX_BYTES (4 * 1024 * 1024)
+#define PLAN_LOOKUP_SORTED 0  // Binary search on the sorted markers only, needs PLAN_SORT_UNIQUE
+#define PLAN_HASH_MAX_BYTES (256 * 1024 * 1024) // Larger hash sets cost too much memory, binary search is used instead
+#define PLAN_LOOKUP_INDEX (PLAN_LOOKUP_HASH | PLAN_LOOKUP_BITMAP | PLAN_LOOKUP_SORTED)
+#define PLAN_SORT_UNIQUE 1  // Radix sort by latitude and longitude without duplicates, 0 = std::sort by latitude
+
+// SOLUTION_2 column loop on row buffers, needs a plan index
+#define COLUMN_KERNEL_SIMD 0  // AVX2/SSE4.1 kernels in double precision
+#define COLUMN_KERNEL_FIXED_POINT 0 // 32.32 fixed point stepping, takes precedence
+#define COLUMN_KERNEL (COLUMN_KERNEL_SIMD | COLUMN_KERNEL_FIXED_POINT)
+
+#if COLUMN_KERNEL & !PLAN_LOOKUP_INDEX
+  #error "The column kernels need PLAN_LOOKUP_HASH, PLAN_LOOKUP_BITMAP or PLAN_LOOKUP_SORTED"
+#endif
+
+// Decode, overlay and display run in separate threads
+#define PIPELINE_WORKERS -1 // Overlay threads, -1 = one per core, 0 = serial loop without threads
+#define PIPELINE_QUEUE 8  // Frames in flight between decode and display
+#define OVERLAY_ROW_THREADS 1 // SOLUTION_2 rows of one frame in parallel, 0 = OpenCV default, for live preview use with PIPELINE_WORKERS 1
 
-// DEBUGGING
-#define CSV_OUTPUT 0
-#define BASH_OUTPUT 0
-#define DEBUG_TIME 0
+// DEBUGGING, see frame_overlay.hpp for the debug output of the solutions
 #define DEBUG_PLAN 0
-#define DEBUG_LINE_MARKING 0
 #define DEBUG_PLAN_CSV 0
-#define DEBUG_MARKING_CSV 0
 #define DEBUG_CAMERA_PATH 0
+#define PRECISION_REPORT 0  // Deviation of float and double from long double, printed at the end
 #define IMAGE_PROCESSING 1
 #define VIDEO1 0
 #define VIDEO2 1
 #define STORE_FRAMES 0
-
-#if DEBUG_TIME
-  #include <chrono>
-#endif
-
-struct GPS_Point {
-  double startLatitude;
-  double startLongitude;
-  double endLatitude;
-  double endLongitude;
-};
-
-struct Line_Marking_Points {
-  /*long double*/int latitude;
-  /*long double*/int longitude;
-};
-
-
-long double degreeToRadiant(long double degree)
-{
-  return (degree * (long double) PI / 180);
-}
-
-
-bool lineMarkCompare(Line_Marking_Points lhs, Line_Marking_Points rhs)
-{
-  return lhs.latitude < rhs.latitude;
-}
-
+#define STORE_FRAMES_FORMAT FRAME_FORMAT_PNG  // FRAME_FORMAT_PNG, FRAME_FORMAT_JPEG or FRAME_FORMAT_PPM
+#define STORE_FRAMES_PNG_COMPRESSION 1  // 0 - 9, higher is smaller and slower
+#define STORE_FRAMES_JPEG_QUALITY 95
+#define STORE_FRAMES_THREADS 2  // Encoder threads
+#define STORE_FRAMES_QUEUE 16 // Frames waiting for an encoder
+#define STORE_FRAMES_BACKPRESSURE FRAME_WRITER_BLOCK  // FRAME_WRITER_BLOCK or FRAME_WRITER_DROP
 
 double longitudeToLatitude(long double latitude)
 {
   return (0.000053979563197308 * pow(latitude, 3) - 0.01911988569736 * pow(latitude, 2) + 0.026419572546895 * latitude + 111.32);
 }
 
-bool comparePositionToLineMark(int pixelPositionEast, int pixelPositionNorth, Line_Marking_Points *lmp, int markingSize)
+
+// Seeking by CAP_PROP_POS_FRAMES is exact for most containers. If the
+// backend can not seek, the frames before are decoded and dropped.
+bool seekToFrame(VideoCapture &video, int frame)
 {
-  int stepSizeIndexing = markingSize / 19;
-  #if DEBUG_LINE_MARKING
-    cout << "pixelPositionEast, pixelPositionNorth, lmp.lat, lmp.long, markingSize" << endl;
-    cout << pixelPositionEast << "; " << pixelPositionNorth << "; " << lmp[0].latitude << "; " << lmp[0].longitude << "; " << markingSize << endl;
-  #endif
-  // cout << "pixelPositionNorth: " << pixelPositionNorth << endl;
-  // cout << "lmp[221].latitude:  " << lmp[221].latitude << endl << endl;
-  // cout << "pixelPositionEast:  " << pixelPositionEast << endl;
-  // cout << "lmp[195].longitude: " << lmp[195].longitude << endl << endl;
+  if(video.set(CAP_PROP_POS_FRAMES, frame) && ((int) video.get(CAP_PROP_POS_FRAMES) == frame))
+    return true;
 
-  for(int indexCounterLat = 0; indexCounterLat < markingSize; indexCounterLat += stepSizeIndexing)
+  cout << "Seeking not supported, skipping " << frame << " frames" << endl;
+  video.set(CAP_PROP_POS_FRAMES, 0);
+  for(int frameCounter = 0; frameCounter < frame; frameCounter++)
   {
-    if((pixelPositionNorth > lmp[indexCounterLat].latitude) & (pixelPositionNorth < lmp[(indexCounterLat + stepSizeIndexing)].latitude))
-    {
-      // approximate match for latitude
-      // cout << "appox match lat" << endl;
-      for(int lmpCounterLat = indexCounterLat; lmpCounterLat < (indexCounterLat + stepSizeIndexing); lmpCounterLat++)
-      {
-        if(pixelPositionNorth == lmp[lmpCounterLat].latitude)
-        {
-          // match for latitude
-          // cout << "match lat" << endl;
-          if(pixelPositionEast == lmp[lmpCounterLat].longitude)
-          {
-            // cout << "match lat" << endl;
-            return true;
-          }
-        }
-      }
-    }
+    if(!video.grab())
+      return false;
   }
-  return false;
+  return true;
 }
 
 
-
 /********************/
 /*** Main routine ***/
 /********************/
 int main (int argc, char ** argv)
 {
-  if (argc < 3)
+  Run_Options runOptions;
+  if (!parseRunOptions(argc, argv, runOptions))
   {
-    cout << "Wrong usage, please specify a video and plan file!" << endl;
+    printRunUsage(argv[0]);
     return -1;
   }
 
+  enableStageTiming(runOptions.timing);
+
+  if (runOptions.merge)
+  {
+    vector<string> shardFileNames(runOptions.mergeFileNames.begin() + 1, runOptions.mergeFileNames.end());
+    return mergeShardVideos(runOptions.mergeFileNames[0], shardFileNames, runOptions.codec) ? 0 : -1;
+  }
+
 
   /******************************************************/
   /*** Parsing of plan file to optain line paramteres ***/
   /******************************************************/
-  const string planFileName = argv[1];
-  ifstream planFile;
-  planFile.open(planFileName);
-  if (!planFile.is_open())
-  {
-    cout << "Could not open plan file!" << endl;
-    return -1;
-  }
-  string line;
-  int dataCounter;
-  GPS_Point *gpsPoint = new GPS_Point[1];
-  GPS_Point *tempGpsPoint = new GPS_Point[1];
-  for(dataCounter = 0; getline(planFile, line); )
+  const string planFileName = runOptions.planFileName;
+  const GPS_Point *gpsPoint = NULL;
+  int dataCounter = 0;
+  const Line_Marking_Points *lineMark = NULL;
+  size_t markingSize = 0;
+  #if PLAN_LOOKUP_INDEX
+    Plan_Index planIndex;
+    Plan_Index *planIndexPointer = &planIndex;
+  #else
+    Plan_Index *planIndexPointer = NULL;
+  #endif
+  const size_t bitmapMaxBytes = (PLAN_LOOKUP_BITMAP && !PLAN_LOOKUP_SORTED) ? PLAN_BITMAP_MAX_BYTES : 0;
+  const size_t hashMaxBytes = PLAN_LOOKUP_SORTED ? 0 : PLAN_HASH_MAX_BYTES;
+
+  // The finished plan from the last run, if the plan file did not change
+  Plan_Cache planCache;
+  planCache.mapping = NULL;
+  Plan_Cache_Settings planCacheSettings = {PLAN_SORT_UNIQUE, PLAN_LOOKUP_INDEX, bitmapMaxBytes, hashMaxBytes};
+  const string planCacheFileName = runOptions.planCacheFileName.empty() ? planFileName + ".idx" : runOptions.planCacheFileName;
+  uint64_t planHash = 0;
+  uint64_t planSize = 0;
+  bool planCached = false;
+  if(runOptions.planCache)
   {
-    if(line.compare(0, 2, "S:") == 0)
-    {
-      // Starting point
-      size_t pos = line.find("/");
-      string latitude = line.substr(2, pos - 2);
-      string longitude = line.substr(pos + 1);
-      size_t stringSize;
-      tempGpsPoint[0].startLatitude = stod(latitude, &stringSize);
-      if(stringSize < 9)
-      {
-        cout << "Error processing starting point of " << dataCounter << ". GPS Line, to few digits" << endl;
-        return -1;
-      }
-      tempGpsPoint[0].startLongitude = stod(longitude, &stringSize);
-      if(stringSize < 9)
-      {
-        cout << "Error processing starting point of " << dataCounter << ". GPS Line, to few digits" << endl;
-        return -1;
-      }
-    }
-    else if (line.compare(0, 2, "E:") == 0)
+    if(!hashPlanFile(planFileName, planHash, planSize))
     {
-      // Ending point
-      size_t pos = line.find("/");
-      string latitude = line.substr(2, pos - 2);
-      string longitude = line.substr(pos + 1);
-      size_t stringSize;
-      tempGpsPoint[0].endLatitude = stod(latitude, &stringSize);
-      if(stringSize < 9)
-      {
-        cout << "Error processing ending point of " << dataCounter << ". GPS Line, to few digits" << endl;
-        return -1;
-      }
-      tempGpsPoint[0].endLongitude = stod(longitude, &stringSize);
-      if(stringSize < 9)
-      {
-        cout << "Error processing ending point of " << dataCounter << ". GPS Line, to few digits" << endl;
-        return -1;
-      }
-      dataCounter++;
-      GPS_Point *temp = new GPS_Point[dataCounter];
-      memcpy(temp, gpsPoint, (dataCounter - 1) * sizeof(GPS_Point));
-      memcpy(temp + (dataCounter - 1), tempGpsPoint, sizeof(GPS_Point));
-      #if DEBUG_PLAN
-        cout.precision(8);
-        cout << "**************************" << endl;
-        for(int debugCounter = 0; debugCounter < dataCounter; debugCounter++)
-        {
-          cout << "TEMP: StartLat:  " << temp[debugCounter].startLatitude << endl;
-          cout << "TEMP: StartLong: " << temp[debugCounter].startLongitude << endl;
-          cout << "TEMP: EndLat:  " << temp[debugCounter].endLatitude << endl;
-          cout << "TEMP: EndLong: " << temp[debugCounter].endLongitude << endl << endl;
-        }
-      #endif
-      delete[] gpsPoint;
-      gpsPoint = temp;
+      cout << "Could not open plan file!" << endl;
+      return -1;
     }
+    planCached = openPlanCache(planCacheFileName, planHash, planSize, planCacheSettings, planCache, planIndexPointer);
+  }
+
+  vector<GPS_Point> planPoints;
+  if(planCached)
+  {
+    gpsPoint = planCache.gpsPoint;
+    dataCounter = planCache.dataCounter;
+    cout << "Plan cache: " << planCacheFileName << endl;
+  }
+  else
+  {
+    if(!loadPlanFile(planFileName, planPoints))
+      return -1;
+    gpsPoint = planPoints.data();
+    dataCounter = planPoints.size();
   }
-  planFile.close();
-  delete[] tempGpsPoint;
 
   #if DEBUG_PLAN
     
@@ -210,35 +182,42 @@ int main (int argc, char ** argv)
   /***********************************/
   /*** Calculation of line markers ***/
   /***********************************/
-  size_t markingSize = 0;
-  Line_Marking_Points *lineMark = new Line_Marking_Points[1];
-  for(int lineCounter = 0; lineCounter < dataCounter; lineCounter++)
+  vector<Line_Marking_Points> lineMarks;
+  if(planCached)
   {
-    double deltaLatitude = gpsPoint[lineCounter].endLatitude - gpsPoint[lineCounter].startLatitude;
-    double deltaLongitude = gpsPoint[lineCounter].endLongitude - gpsPoint[lineCounter].startLongitude;
-    int steps;
-    if (abs(deltaLatitude) > abs(deltaLongitude))
-      steps = abs(deltaLatitude) * 1000000;
-    else
-      steps = abs(deltaLongitude) * 1000000;
+    lineMark = planCache.lineMark;
+    markingSize = planCache.markingSize;
+  }
+  else
+  {
+    rasterizePlan(gpsPoint, dataCounter, lineMarks);
+
+    #if PLAN_SORT_UNIQUE
+      size_t rasterizedSize = lineMarks.size();
+      sortUniqueLineMarks(lineMarks);
+      cout << "Line markers: " << lineMarks.size() << " (" << (rasterizedSize - lineMarks.size()) << " duplicates removed)" << endl;
+    #else
+      sort(lineMarks.begin(), lineMarks.end(), lineMarkCompare);
+    #endif
+    lineMark = lineMarks.data();
+    markingSize = lineMarks.size();
 
-    cout.precision(8);
-    Line_Marking_Points *tempLineMark = new Line_Marking_Points[++steps];
-    for(int stepCounter = 0; stepCounter < steps; stepCounter++)
-    {
-      tempLineMark[stepCounter].latitude = (gpsPoint[lineCounter].startLatitude + (long double) stepCounter * (deltaLatitude / (long double) (steps - 1))) * 1000000;
-      tempLineMark[stepCounter].longitude = (gpsPoint[lineCounter].startLongitude + (double) stepCounter * (deltaLongitude / (double) (steps - 1))) * 1000000;
-    }
-    markingSize += steps;
-    Line_Marking_Points *temp = new Line_Marking_Points[markingSize];
-    memcpy(temp, lineMark, (markingSize - steps) * sizeof(Line_Marking_Points));
-    memcpy(temp + (markingSize - steps), tempLineMark, steps * sizeof(Line_Marking_Points));
-    delete[] lineMark;
-    lineMark = temp;
-    delete[] tempLineMark;
+    #if PLAN_LOOKUP_INDEX
+      buildPlanIndex(planIndex, lineMark, markingSize, bitmapMaxBytes, hashMaxBytes);
+    #endif
+
+    if(runOptions.planCache && !writePlanCache(planCacheFileName, planHash, planSize, planCacheSettings, gpsPoint, dataCounter, lineMark, markingSize, planIndexPointer))
+      cout << "Could not write plan cache " << planCacheFileName << ", continuing without" << endl;
   }
 
-  sort(lineMark, lineMark + markingSize, lineMarkCompare);
+  #if PLAN_LOOKUP_INDEX
+    if(planIndex.type == PLAN_INDEX_BITMAP)
+      cout << "Plan index: bitmap " << planIndex.bitmap.latitudeCells << " x " << planIndex.bitmap.longitudeCells << " cells" << endl;
+    else if(planIndex.type == PLAN_INDEX_SORTED)
+      cout << "Plan index: binary search on " << planIndex.sorted.markingSize << " markers" << endl;
+    else
+      cout << "Plan index: hash set " << (planIndex.hash.slotMask + 1) << " slots" << endl;
+  #endif
 
 
   #if DEBUG_PLAN
@@ -263,7 +242,7 @@ int main (int argc, char ** argv)
   /*** Image processing ***/
   /************************/
   #if IMAGE_PROCESSING
-  const string videoSrc = argv[2];
+  const string videoSrc = runOptions.videoFileName;
   VideoCapture captVidSrc(videoSrc);
 
   if(!captVidSrc.isOpened())
@@ -274,7 +253,8 @@ int main (int argc, char ** argv)
 
   // Windows
   const char * WIN_SRC = "Source Video";
-  namedWindow(WIN_SRC, WINDOW_AUTOSIZE);
+  if(!runOptions.headless)
+    namedWindow(WIN_SRC, WINDOW_AUTOSIZE);
 
   // Image data
   int frameHeight = 0;
@@ -283,6 +263,22 @@ int main (int argc, char ** argv)
   frameHeight = captVidSrc.get(CAP_PROP_FRAME_HEIGHT);
   frameWidth = captVidSrc.get(CAP_PROP_FRAME_WIDTH);
 
+  // Annotated output video
+  VideoWriter outputVideo;
+  if(!runOptions.outputFileName.empty())
+  {
+    double framesPerSecond = captVidSrc.get(CAP_PROP_FPS);
+    if(framesPerSecond <= 0)
+      framesPerSecond = 30;
+    const string &codec = runOptions.codec;
+    outputVideo.open(runOptions.outputFileName, VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]), framesPerSecond, Size(frameWidth, frameHeight), true);
+    if(!outputVideo.isOpened())
+    {
+      cout << "Could not open output video " << runOptions.outputFileName << " with codec " << codec << "!" << endl;
+      return -1;
+    }
+  }
+
   #if VIDEO1
     long double latitudeStart = 48.3788083;
     long double longitudeStart = 16.8258389;
@@ -298,254 +294,231 @@ int main (int argc, char ** argv)
     double direction = 150;
   #endif
 
-  long double latitudePath[(int)captVidSrc.get(CAP_PROP_FRAME_COUNT)];
-  long double longitudePath[(int)captVidSrc.get(CAP_PROP_FRAME_COUNT)];
+  // Unreliable or unknown for some streams, pipes and live capture
+  double frameCount = captVidSrc.get(CAP_PROP_FRAME_COUNT);
+
+  if(!resolveFrameRange(runOptions, frameCount))
+    return -1;
+  const int startFrame = runOptions.startFrame;
+  const int endFrame = runOptions.endFrame;
+  if(startFrame > 0 && !seekToFrame(captVidSrc, startFrame))
+  {
+    cout << "Could not seek to frame " << startFrame << "!" << endl;
+    return -1;
+  }
+  if(startFrame > 0 || endFrame >= 0)
+    cout << "Frames " << startFrame << " to " << ((endFrame >= 0) ? to_string(endFrame) : string("end")) << endl;
 
   double tilt = 89;
-  Mat frame;
 
-  int frameCounter = 0;
+  // A GPS track replaces the straight path of VIDEO1 / VIDEO2
+  Pose_Source poseSource;
+  GPS_Track gpsTrack;
+  poseSource.track = NULL;
+  poseSource.trackOffset = runOptions.trackOffset;
+  poseSource.trackInterpolation = runOptions.trackInterpolation;
+  poseSource.latitudeStart = latitudeStart;
+  poseSource.longitudeStart = longitudeStart;
+  poseSource.latitudeEnd = latitudeEnd;
+  poseSource.longitudeEnd = longitudeEnd;
+  poseSource.direction = direction;
+  poseSource.tilt = tilt;
+  // The camera path runs over the whole video, also if only a range is processed
+  poseSource.pathFrames = (runOptions.pathFrames > 0) ? runOptions.pathFrames : frameCount;
+  if(!runOptions.trackFileName.empty())
+  {
+    if(!loadGpsTrack(runOptions.trackFileName, gpsTrack))
+      return -1;
+    cout << "GPS track: " << gpsTrack.samples.size() << " samples over " << (gpsTrack.samples.back().time - gpsTrack.samples.front().time) << " s" << endl;
+    poseSource.track = &gpsTrack;
+  }
+  else if(poseSource.pathFrames <= 0)
+  {
+    cout << "The video does not report its frame count, please give --path-frames or a --track!" << endl;
+    return -1;
+  }
+
+  Overlay_Context overlayContext;
+  overlayContext.settings.solution1 = SOLUTION_1;
+  overlayContext.settings.solution2 = SOLUTION_2;
+  overlayContext.settings.solution3 = SOLUTION_3;
+  overlayContext.settings.solution4 = SOLUTION_4;
+  overlayContext.settings.planLookup = PLAN_LOOKUP_INDEX ? OVERLAY_LOOKUP_INDEX : OVERLAY_LOOKUP_REFERENCE;
+  overlayContext.settings.columnKernel = COLUMN_KERNEL_FIXED_POINT ? OVERLAY_KERNEL_FIXED_POINT : (COLUMN_KERNEL_SIMD ? OVERLAY_KERNEL_SIMD : OVERLAY_KERNEL_NONE);
+  overlayContext.settings.rowThreads = OVERLAY_ROW_THREADS;
+  overlayContext.settings.mask = !runOptions.maskFileName.empty();
+  overlayContext.gpsPoint = gpsPoint;
+  overlayContext.dataCounter = dataCounter;
+  overlayContext.lineMark = lineMark;
+  overlayContext.markingSize = markingSize;
+  #if PLAN_LOOKUP_INDEX
+    overlayContext.planIndex = &planIndex;
+  #else
+    overlayContext.planIndex = NULL;
+  #endif
+  overlayContext.tilt = tilt;
+  buildCameraGeometry(overlayContext.cameraGeometry, tilt, frameWidth, frameHeight);
+
+  #if COLUMN_KERNEL
+    cout << "Column kernel: " << (COLUMN_KERNEL_FIXED_POINT ? "fixed point" : columnKernelName()) << endl;
+  #endif
+
+  #if PRECISION_REPORT
+    Precision_Report precisionReport;
+    initPrecisionReport(precisionReport, tilt, frameWidth, frameHeight);
+  #endif
+
+  Frame_Pipeline_Settings pipelineSettings;
+  pipelineSettings.workerCount = (PIPELINE_WORKERS < 0) ? defaultPipelineWorkers() : PIPELINE_WORKERS;
+  pipelineSettings.queueCapacity = PIPELINE_QUEUE;
+  cout << "Overlay threads: " << pipelineSettings.workerCount << endl;
+  if(OVERLAY_ROW_THREADS > 1)
+    setNumThreads(OVERLAY_ROW_THREADS);
+
+  vector<Overlay_Worker> overlayWorkers(max(1, pipelineSettings.workerCount));
+  for(size_t workerCounter = 0; workerCounter < overlayWorkers.size(); workerCounter++)
+    initOverlayWorker(overlayWorkers[workerCounter], overlayContext);
+
+  #if STORE_FRAMES
+    Frame_Writer_Settings frameWriterSettings;
+    frameWriterSettings.format = STORE_FRAMES_FORMAT;
+    frameWriterSettings.pngCompression = STORE_FRAMES_PNG_COMPRESSION;
+    frameWriterSettings.jpegQuality = STORE_FRAMES_JPEG_QUALITY;
+    frameWriterSettings.threadCount = STORE_FRAMES_THREADS;
+    frameWriterSettings.queueCapacity = STORE_FRAMES_QUEUE;
+    frameWriterSettings.backpressure = STORE_FRAMES_BACKPRESSURE;
+    Frame_Writer frameWriter(frameWriterSettings);
+  #endif
+
+  // Only SOLUTION_2 marks its matches, the other solutions leave the masks empty
+  Mask_Writer maskWriter;
+  if(!runOptions.maskFileName.empty())
+  {
+    if(!SOLUTION_2)
+      cout << "The mask stream needs SOLUTION_2, all masks will be empty" << endl;
+    if(!maskWriter.open(runOptions.maskFileName, frameWidth, frameHeight))
+      return -1;
+  }
+
+  cout.precision(9);
+
 
-  while(1)
+  /*** Decode stage ***/
+  int framesDecoded = 0;
+  Decode_Stage decodeFrame = [&](Mat &frame, double &timestamp)
   {
+    if(endFrame >= 0 && startFrame + framesDecoded >= endFrame)
+      return false;
+    framesDecoded++;
+    int64_t begin = stageTimingBegin();
     if(!captVidSrc.read(frame))
     {
       cout << "All frames read or error reading a frame" << endl;
-      break;
+      return false;
     }
+    timestamp = captVidSrc.get(CAP_PROP_POS_MSEC);
+    stageTimingEnd(TIMING_STAGE_DECODE, begin, startFrame + framesDecoded - 1);
+    return true;
+  };
 
-    latitudePath[frameCounter] = latitudeStart +  ((latitudeEnd - latitudeStart) / captVidSrc.get(CAP_PROP_FRAME_COUNT)) * frameCounter;
-    longitudePath[frameCounter] = longitudeStart +  ((longitudeEnd - longitudeStart) / captVidSrc.get(CAP_PROP_FRAME_COUNT)) * frameCounter;
+
+  /*** Overlay stage ***/
+  Overlay_Stage overlayStage = [&](Mat &frame, int frameIndex, double timestamp, int workerIndex)
+  {
+    int frameCounter = startFrame + frameIndex;  // Index in the whole video
+    Camera_Pose pose;
+    int64_t begin = stageTimingBegin();
+    poseOfFrame(poseSource, frameCounter, timestamp, pose);
+    stageTimingEnd(TIMING_STAGE_POSE, begin, frameCounter);
 
     #if DEBUG_CAMERA_PATH
-      cout << "latPath" << frameCounter << ":  " << latitudePath[frameCounter] << endl;
-      cout << "longPath" << frameCounter << ": " << longitudePath[frameCounter] << endl << endl;
+      cout << "latPath" << frameCounter << ":  " << pose.latitude << endl;
+      cout << "longPath" << frameCounter << ": " << pose.longitude << endl << endl;
     #endif
 
-    // GPS Data
-    
-
-    // Position variables
+    overlayFrame(frame, overlayContext, pose, overlayWorkers[workerIndex], frameCounter);
+    if(maskWriter.isOpen())
+      maskWriter.write(frameCounter, overlayWorkers[workerIndex].mask);
+  };
 
-    // Coordinate variables
-    long double distanceOfBaseline;
-    long double distanceOfSideline;
-    long double distanceOfBaselineCenterNorth;
-    long double distanceOfBaselineCenterEast;
-    long double distanceOfSidelineNorth;
-    long double distanceOfSidelineEast;
-    int pixelPositionEast;
-    int pixelPositionNorth;
-
-    cout.precision(9);
-
-    long double halfFrameHeight = (double) frameHeight / 2;
-    long double halfFrameWidth = (double) frameWidth / 2;
-
-    #if CSV_OUTPUT
-      #if SOLUTION_1
-        cout << "row;column;pixelPositionEast;pixelPositionNorth;" << endl;
-      #endif
-      #if SOLUTION_2
-        cout << "row;column;distanceOfBaseline;pixelPositionEast;pixelPositionNorth" << endl;
-      #endif
-    #endif
 
-    #if DEBUG_TIME
-      auto begin = chrono::high_resolution_clock::now();
+  /*** Display stage, in frame order on the main thread ***/
+  Sink_Stage displayFrame = [&](Mat &frame, int frameIndex, double timestamp)
+  {
+    int frameCounter = startFrame + frameIndex;
+    #if PRECISION_REPORT
+      Camera_Pose pose;
+      poseOfFrame(poseSource, frameCounter, timestamp, pose);
+      updatePrecisionReport(precisionReport, pose.latitude, pose.longitude, pose.direction);
+    #else
+      (void) timestamp;
     #endif
 
-
-/****************************************/
-/*** Solution 1, purely trigonometric ***/
-/****************************************/
-#if SOLUTION_1
-    for (int row = 1; row <= frameHeight; row++)
+    if(outputVideo.isOpened())
     {
-      long double baselinePixelAngle = (tilt + ((long double) AOV_V / 2)) - (((long double) frameHeight - (row - 1)) / (long double) frameHeight) * (long double) AOV_V;
-      if(baselinePixelAngle > 87)
-        break;    // Aborting calulation because the distance is irrelevant
-      distanceOfBaseline = tan(degreeToRadiant(baselinePixelAngle)) * (long double) HEIGHT;
-      distanceOfBaselineCenterEast = sin(degreeToRadiant(direction)) * distanceOfBaseline;
-      distanceOfBaselineCenterNorth = cos(degreeToRadiant(direction)) * distanceOfBaseline;
-
-      for (int column = 1; column <= frameWidth; column++)
-      {
-        long double sidelinePixelAngle;
-        if (column < (halfFrameWidth + 1))  // Left image side
-        {
-          sidelinePixelAngle = ((long double) AOV_H / 2) * (halfFrameWidth - (column - 1)) / halfFrameWidth;
-          distanceOfSideline = tan(degreeToRadiant(sidelinePixelAngle)) * distanceOfBaseline;
-          distanceOfSidelineEast = - cos(degreeToRadiant(direction)) * distanceOfSideline;
-          distanceOfSidelineNorth = sin(degreeToRadiant(direction)) * distanceOfSideline;
-        }
-        else  // Right image side
-        {
-          sidelinePixelAngle = ((long double) AOV_H / 2) * ((column - 1) - halfFrameWidth) / halfFrameWidth;
-          distanceOfSideline = tan(degreeToRadiant(sidelinePixelAngle)) * distanceOfBaseline;
-          distanceOfSidelineEast = cos(degreeToRadiant(direction)) * distanceOfSideline;
-          distanceOfSidelineNorth = - sin(degreeToRadiant(direction)) * distanceOfSideline;
-        }
-
-        long double pixelDistanceEast = distanceOfBaselineCenterEast + distanceOfSidelineEast;
-        long double pixelDistanceNorth = distanceOfBaselineCenterNorth + distanceOfSidelineNorth;
-
-        pixelPositionEast = longitudePath[frameCounter] + ((pixelDistanceEast / 1000000) / 111.32);
-        pixelPositionNorth = latitudePath[frameCounter] + ((pixelDistanceNorth / 1000000) / 111.32);
-
-        #if BASH_OUTPUT
-          cout << "Angle: " << sidelinePixelAngle << ";distanceOfSideline: " << distanceOfSideline << ";distanceOfSidelineEast: " << distanceOfSidelineEast << endl;  
-          if (column > 100)
-            return 0;
-        #endif
-
-        #if CSV_OUTPUT
-          cout << row << ";" << column<< ";" << pixelPositionEast << ";" << pixelPositionNorth << ";" << endl;
-        #endif
-
-
-      }
+      int64_t begin = stageTimingBegin();
+      outputVideo.write(frame);
+      stageTimingEnd(TIMING_STAGE_ENCODE, begin, frameCounter);
     }
-#endif /**** SOLUTION 1 ****/
 
-
-
-/******************************************************/
-/*** Solution 2, triginometric and linear equations ***/
-/******************************************************/
-#if SOLUTION_2
-    for (int row = 1; row <= frameHeight; row++)
+    if(!runOptions.headless)
     {
-      long double baselinePixelAngle = (tilt + ((long double) AOV_V / 2)) - (((long double) frameHeight - (row - 1)) / (long double) frameHeight) * (long double) AOV_V;
-      if(baselinePixelAngle > 87)
-        break;    // Aborting calulation because the distance is irrelevant
-      distanceOfBaseline = tan(degreeToRadiant(baselinePixelAngle)) * (long double) HEIGHT;
-      distanceOfBaselineCenterEast = sin(degreeToRadiant(direction)) * distanceOfBaseline;
-      distanceOfBaselineCenterNorth = cos(degreeToRadiant(direction)) * distanceOfBaseline;
-      long double distanceOfBaselineCenterEastGPS = (distanceOfBaselineCenterEast / 1000000) / 111.32;
-      long double distanceOfBaselineCenterNorthGPS = (distanceOfBaselineCenterNorth / 1000000) / 111.32;
-
-      distanceOfSideline = tan(degreeToRadiant((long double) AOV_H / 2)) * distanceOfBaseline;
-      // Left point of view
-      distanceOfSidelineEast = - cos(degreeToRadiant(direction)) * distanceOfSideline;
-      distanceOfSidelineNorth = sin(degreeToRadiant(direction)) * distanceOfSideline;
-      long double distanceOfSidelineEastGPS = (distanceOfSidelineEast / 1000000) / 111.32;  // change to latitude position!!!!*********************
-      long double distanceOfSidelineNorthGPS = (distanceOfSidelineNorth / 1000000) / 111.32;
-
-      long double longitudeLeftPoint = longitudePath[frameCounter] + distanceOfBaselineCenterEastGPS + distanceOfSidelineEastGPS;
-      long double latitudeLeftPoint = latitudePath[frameCounter] + distanceOfBaselineCenterNorthGPS + distanceOfSidelineNorthGPS;
-
-      #if BASH_OUTPUT
-        cout << "longitude: " << longitudePath[frameCounter] << endl;
-        cout << "latitude:  " << latitudePath[frameCounter] << endl;
-        cout << "distanceOfBaselineCenterEast:  " << distanceOfBaselineCenterEast << endl;
-        cout << "distanceOfBaselineCenterNorth: " << distanceOfBaselineCenterNorth << endl;
-        cout << "****Left point of view****" << endl;
-        cout << "distanceOfSidelineEast:  " << distanceOfSidelineEast << endl;
-        cout << "distanceOfSidelineNorth: " << distanceOfSidelineNorth << endl;
-        cout << "distanceOfSidelineEastGPS:  " << distanceOfSidelineEastGPS << endl;
-        cout << "distanceOfSidelineNorthGPS: " << distanceOfSidelineNorthGPS << endl;
-      #endif
-
-      // Right point of view
-      distanceOfSidelineEast = cos(degreeToRadiant(direction)) * distanceOfSideline;
-      distanceOfSidelineNorth = - sin(degreeToRadiant(direction)) * distanceOfSideline;
-      distanceOfSidelineEastGPS = (distanceOfSidelineEast / 1000000) / 111.32;
-      distanceOfSidelineNorthGPS = (distanceOfSidelineNorth / 1000000) / 111.32;
-
-      long double longitudeRightPoint = longitudePath[frameCounter] + distanceOfBaselineCenterEastGPS + distanceOfSidelineEastGPS;
-      long double latitudeRightPoint = latitudePath[frameCounter] + distanceOfBaselineCenterNorthGPS + distanceOfSidelineNorthGPS;
-
-      #if BASH_OUTPUT
-        cout << "****Right point of View****" << endl;
-        cout << "distanceOfSidelineEast:  " << distanceOfSidelineEast << endl;
-        cout << "distanceOfSidelineNorth: " << distanceOfSidelineNorth << endl;
-        cout << "distanceOfSidelineEastGPS:  " << distanceOfSidelineEastGPS << endl;
-        cout << "distanceOfSidelineNorthGPS: " << distanceOfSidelineNorthGPS << endl;
-        cout << "Longitude L/R: " <<  longitudeLeftPoint << " / " << longitudeRightPoint << endl;
-        cout << "Latitude  L/R: " << latitudeLeftPoint << " / " << latitudeRightPoint << endl;
-        if (row > 10)
-          return 0;
-      #endif
-
-      long double deviationEast = longitudeRightPoint - longitudeLeftPoint;
-      long double deviationNorth = latitudeRightPoint - latitudeLeftPoint;
+      int64_t begin = stageTimingBegin();
+      imshow(WIN_SRC, frame);
 
-      long double steppingWidthEast = (deviationEast / (long double) frameWidth);
-      long double steppingWidthNorth = deviationNorth / (long double) frameWidth;
 
-      #if BASH_OUTPUT
-        cout << "*******" << endl;
-        cout << "deviationEast:  " << deviationEast << endl;
-        cout << "deviationNorth: " << deviationNorth << endl;
-        cout << "steppingWidthEast:  " << steppingWidthEast << endl;
-        cout << "steppingWidthNorth: " << steppingWidthNorth << endl << endl;
+      #if CSV_OUTPUT | DEBUG_MARKING_CSV
+        waitKey(0);
+        return false;
       #endif
 
-      for (int column = 1; column <= frameWidth; column++)
+
+      int key = waitKey(1);
+      stageTimingEnd(TIMING_STAGE_DISPLAY, begin, frameCounter);
+      if(key >= 0)
       {
-        pixelPositionEast = (int)((longitudeLeftPoint + column * steppingWidthEast) * 1000000);
-        pixelPositionNorth = (int)((latitudeLeftPoint + column * steppingWidthNorth) * 1000000);
-        #if BASH_OUTPUT
-          cout << "East: " << pixelPositionEast << "\tNorth: " << pixelPositionNorth <<  endl;
-          if (column > 10)
-            return 0;
-        #endif
-        #if CSV_OUTPUT
-          cout << row << ";" << column<< ";" << distanceOfBaseline << ";" << pixelPositionEast << ";" << pixelPositionNorth << endl;
-        #endif
-
-        /*** Compare image position ***/
-        bool match = comparePositionToLineMark(pixelPositionEast, pixelPositionNorth, lineMark, markingSize);
-        #if DEBUG_MARKING_CSV
-          cout << column << ";" << row << ";" << pixelPositionNorth << ";" << pixelPositionEast << endl;
-        #endif
-        if(match == true)
-        {
-          int x = frameHeight - row;
-          int y = column;
-          // cout << x << " / " << y << endl;
-          frame.at<Vec3b>(x, y) = Vec3b(0, 0, 255);
-          // frame.at<Vec3b>(column, row) = Vec3b(0, 0, 255);
-        }
+        return false;
       }
     }
-#endif  /**** SOLUTION 2 ****/
-
-    frameCounter++;
-
-    #if DEBUG_TIME
-      auto end = chrono::high_resolution_clock::now();
-      auto dur = end - begin;
-      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
-      cout << ms << endl;
-    #endif
-
-    imshow(WIN_SRC, frame);
-
-
     #if CSV_OUTPUT | DEBUG_MARKING_CSV
-      waitKey(0);
-      return 0;
+      else
+        return false;
     #endif
 
-
-    if(waitKey(1) >= 0)
-    {
-      break;
-    }
-
     #if STORE_FRAMES
       string frameName = "./Frames/VideoFrame";
-      frameName.append(to_string(frameCounter));
-      frameName.append(".png");
-      imwrite(frameName, frame);
+      frameName.append(to_string(frameCounter + 1));
+      frameName.append(frameFormatExtension(STORE_FRAMES_FORMAT));
+      frameWriter.write(frame, frameName);
     #endif
+    return true;
+  };
+
+  if(!runOptions.traceFileName.empty() && !startFrameTrace(runOptions.traceFileName))
+    return -1;
+  runFramePipeline(pipelineSettings, decodeFrame, overlayStage, displayFrame);
+  outputVideo.release();
+  if(maskWriter.isOpen() && maskWriter.finish())
+    cout << "Mask stream: " << maskWriter.framesWritten() << " frames, " << maskWriter.bytesWritten() << " bytes" << endl;
+
+  #if STORE_FRAMES
+    frameWriter.finish();
+    cout << "Frames stored: " << frameWriter.framesWritten() << ", dropped: " << frameWriter.framesDropped() << endl;
+  #endif
+
+  #if PRECISION_REPORT
+    printPrecisionReport(precisionReport);
+  #endif
+
+  stopFrameTrace();
+  if(stageTimingEnabled())
+  {
+    printStageTimingReport();
+    if(!runOptions.timingFileName.empty())
+      writeStageTimingJson(runOptions.timingFileName);
   }
-  
   #endif
-  delete[] lineMark;
-  delete[] gpsPoint;
+  closePlanCache(planCache);
   cout << "Mem cleared" << endl;
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "run_options.hpp"
+#include "gps_track.hpp"
+
+using namespace std;
+
+#define DEFAULT_OUTPUT_CODEC "mp4v"
+
+
+void printRunUsage(const char *programName)
+{
+  cout << "Usage: " << programName << " <plan file> <video file> [options]" << endl;
+  cout << "  --output <file>   Write the annotated video to <file>, implies --headless" << endl;
+  cout << "  --codec <fourcc>  Codec of the output video, default " << DEFAULT_OUTPUT_CODEC << endl;
+  cout << "  --headless        No preview window" << endl;
+  cout << "  --start-frame <n>  First frame to process" << endl;
+  cout << "  --end-frame <n>    Stop before frame <n>" << endl;
+  cout << "  --shard <i>/<n>    Process the i. of n equal parts of the frame range, i counts from 0" << endl;
+  cout << "  --track <file>     Camera poses from a GPS track, .csv, .gpx or .nmea" << endl;
+  cout << "  --track-offset <s> Track time of the first video frame, relative to the first sample" << endl;
+  cout << "  --interpolation linear|cubic  Interpolation between the track samples, default linear" << endl;
+  cout << "  --path-frames <n>  Frames of the built in camera path, for videos without a frame count" << endl;
+  cout << "  --plan-cache <file> Binary cache of the finished plan, default <plan file>.idx" << endl;
+  cout << "  --no-plan-cache    Always build the plan from the text file" << endl;
+  cout << "  --timing           Print p50/p95/p99/max of every stage at the end" << endl;
+  cout << "  --timing-json <file> Also write the stage timing as JSON, implies --timing" << endl;
+  cout << "  --trace <file>     Chrome trace / Perfetto JSON of the stages of every frame" << endl;
+  cout << "  --mask <file>      Matched pixels of every frame as run length encoded rows" << endl;
+  cout << "Usage: " << programName << " --merge <output video> <shard video> ... [--codec <fourcc>]" << endl;
+  cout << "  Concatenates the shard outputs in the given order. The frames are decoded and" << endl;
+  cout << "  encoded again with the codec of the shards, a lossy codec loses quality a second" << endl;
+  cout << "  time. --codec only confirms the codec, it has to match the shards." << endl;
+}
+
+
+static bool nextArgument(int argc, char **argv, int &argumentCounter, string &value)
+{
+  if(argumentCounter + 1 >= argc)
+  {
+    cout << "Missing value for " << argv[argumentCounter] << endl;
+    return false;
+  }
+  value = argv[++argumentCounter];
+  return true;
+}
+
+
+static bool nextFrameArgument(int argc, char **argv, int &argumentCounter, int &frame)
+{
+  string value;
+  if(!nextArgument(argc, argv, argumentCounter, value))
+    return false;
+  char *end;
+  long number = strtol(value.c_str(), &end, 10);
+  if(value.empty() || *end != '\0' || number < 0 || number > 0x7fffffff)
+  {
+    cout << "Invalid frame number for " << argv[argumentCounter - 1] << ": " << value << endl;
+    return false;
+  }
+  frame = number;
+  return true;
+}
+
+
+bool parseRunOptions(int argc, char **argv, Run_Options &options)
+{
+  options.headless = false;
+  options.outputFileName.clear();
+  options.codec.clear();
+  options.startFrame = 0;
+  options.endFrame = -1;
+  options.shardIndex = 0;
+  options.shardCount = 0;
+  options.trackFileName.clear();
+  options.trackOffset = 0;
+  options.trackInterpolation = TRACK_INTERPOLATION_LINEAR;
+  options.pathFrames = 0;
+  options.planCache = true;
+  options.planCacheFileName.clear();
+  options.timing = false;
+  options.timingFileName.clear();
+  options.traceFileName.clear();
+  options.maskFileName.clear();
+  options.merge = false;
+  options.mergeFileNames.clear();
+
+  int positionalCounter = 0;
+  for(int argumentCounter = 1; argumentCounter < argc; argumentCounter++)
+  {
+    const char *argument = argv[argumentCounter];
+    if(strcmp(argument, "--output") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.outputFileName))
+        return false;
+      options.headless = true;
+    }
+    else if(strcmp(argument, "--codec") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.codec))
+        return false;
+      if(options.codec.size() != 4)
+      {
+        cout << "The codec has to be a FOURCC with four characters, e.g. mp4v" << endl;
+        return false;
+      }
+    }
+    else if(strcmp(argument, "--headless") == 0)
+    {
+      options.headless = true;
+    }
+    else if(strcmp(argument, "--start-frame") == 0)
+    {
+      if(!nextFrameArgument(argc, argv, argumentCounter, options.startFrame))
+        return false;
+    }
+    else if(strcmp(argument, "--end-frame") == 0)
+    {
+      if(!nextFrameArgument(argc, argv, argumentCounter, options.endFrame))
+        return false;
+    }
+    else if(strcmp(argument, "--shard") == 0)
+    {
+      string value;
+      if(!nextArgument(argc, argv, argumentCounter, value))
+        return false;
+      if(sscanf(value.c_str(), "%d/%d", &options.shardIndex, &options.shardCount) != 2 || options.shardCount < 1 || options.shardIndex < 0 || options.shardIndex >= options.shardCount)
+      {
+        cout << "Invalid shard " << value << ", expected <index>/<count> with 0 <= index < count" << endl;
+        return false;
+      }
+    }
+    else if(strcmp(argument, "--track") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.trackFileName))
+        return false;
+    }
+    else if(strcmp(argument, "--track-offset") == 0)
+    {
+      string value;
+      if(!nextArgument(argc, argv, argumentCounter, value))
+        return false;
+      char *end;
+      options.trackOffset = strtod(value.c_str(), &end);
+      if(value.empty() || *end != '\0')
+      {
+        cout << "Invalid track offset " << value << endl;
+        return false;
+      }
+    }
+    else if(strcmp(argument, "--interpolation") == 0)
+    {
+      string value;
+      if(!nextArgument(argc, argv, argumentCounter, value))
+        return false;
+      if(value == "linear")
+        options.trackInterpolation = TRACK_INTERPOLATION_LINEAR;
+      else if(value == "cubic")
+        options.trackInterpolation = TRACK_INTERPOLATION_CUBIC;
+      else
+      {
+        cout << "Unknown interpolation " << value << ", expected linear or cubic" << endl;
+        return false;
+      }
+    }
+    else if(strcmp(argument, "--path-frames") == 0)
+    {
+      if(!nextFrameArgument(argc, argv, argumentCounter, options.pathFrames))
+        return false;
+    }
+    else if(strcmp(argument, "--plan-cache") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.planCacheFileName))
+        return false;
+      options.planCache = true;
+    }
+    else if(strcmp(argument, "--no-plan-cache") == 0)
+    {
+      options.planCache = false;
+    }
+    else if(strcmp(argument, "--timing") == 0)
+    {
+      options.timing = true;
+    }
+    else if(strcmp(argument, "--timing-json") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.timingFileName))
+        return false;
+      options.timing = true;
+    }
+    else if(strcmp(argument, "--trace") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.traceFileName))
+        return false;
+    }
+    else if(strcmp(argument, "--mask") == 0)
+    {
+      if(!nextArgument(argc, argv, argumentCounter, options.maskFileName))
+        return false;
+    }
+    else if(strcmp(argument, "--merge") == 0)
+    {
+      options.merge = true;
+    }
+    else if(strncmp(argument, "--", 2) == 0)
+    {
+      cout << "Unknown option " << argument << endl;
+      return false;
+    }
+    else if(options.merge)
+    {
+      options.mergeFileNames.push_back(argument);
+    }
+    else if(positionalCounter == 0)
+    {
+      options.planFileName = argument;
+      positionalCounter++;
+    }
+    else if(positionalCounter == 1)
+    {
+      options.videoFileName = argument;
+      positionalCounter++;
+    }
+    else
+    {
+      cout << "Too many arguments: " << argument << endl;
+      return false;
+    }
+  }
+
+  if(options.merge)
+  {
+    if(options.mergeFileNames.size() < 2)
+    {
+      cout << "Merging needs an output video and at least one shard video!" << endl;
+      return false;
+    }
+    return true;
+  }
+  if(options.codec.empty())
+    options.codec = DEFAULT_OUTPUT_CODEC;
+
+  if(options.endFrame >= 0 && options.endFrame <= options.startFrame)
+  {
+    cout << "The end frame has to be behind the start frame!" << endl;
+    return false;
+  }
+
+  if(positionalCounter < 2)
+  {
+    cout << "Wrong usage, please specify a video and plan file!" << endl;
+    return false;
+  }
+  return true;
+}
+
+
+bool resolveFrameRange(Run_Options &options, int frameCount)
+{
+  if(options.shardCount == 0)
+  {
+    if(frameCount > 0 && options.startFrame >= frameCount)
+    {
+      cout << "The start frame " << options.startFrame << " is behind the end of the video (" << frameCount << " frames)!" << endl;
+      return false;
+    }
+    return true;
+  }
+
+  int rangeEnd = options.endFrame;
+  if(rangeEnd < 0)
+  {
+    if(frameCount <= 0)
+    {
+      cout << "The video does not report its frame count, sharding needs --end-frame!" << endl;
+      return false;
+    }
+    rangeEnd = frameCount;
+  }
+
+  // The same split in every process, the shards cover the range without gaps
+  long long rangeLength = rangeEnd - options.startFrame;
+  int rangeStart = options.startFrame;
+  options.startFrame = rangeStart + (int) (rangeLength * options.shardIndex / options.shardCount);
+  options.endFrame = rangeStart + (int) (rangeLength * (options.shardIndex + 1) / options.shardCount);
+  return true;
+}
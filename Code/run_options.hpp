@@ -0,0 +1,40 @@
+#ifndef RUN_OPTIONS_HPP
+#define RUN_OPTIONS_HPP
+
+#include <string>
+#include <vector>
+
+// Settings given on the command line, the compile switches in main stay the defaults
+struct Run_Options {
+  std::string planFileName;
+  std::string videoFileName;
+  bool headless;  // No HighGUI window, frames go to the output video only
+  std::string outputFileName; // Annotated video, container chosen by the file extension
+  std::string codec;  // FOURCC of the output video, e.g. mp4v, MJPG, XVID, avc1, empty with --merge = codec of the shards
+  int startFrame; // First frame to process
+  int endFrame; // Frame after the last one to process, -1 = end of the video
+  int shardIndex;
+  int shardCount; // 0 = no sharding, otherwise the range is split into shardCount parts
+  std::string trackFileName;  // GPS track with the camera poses, empty = path of VIDEO1 / VIDEO2
+  double trackOffset; // Seconds from the first track sample to the first video frame
+  int trackInterpolation; // TRACK_INTERPOLATION_LINEAR or TRACK_INTERPOLATION_CUBIC
+  bool planCache; // Keep the finished plan in a binary cache file
+  std::string planCacheFileName;  // Empty = plan file name + ".idx"
+  int pathFrames;  // Length of the VIDEO1 / VIDEO2 path in frames, 0 = frame count of the video
+  bool timing; // Latency histograms of the stages, printed at the end
+  std::string timingFileName; // Same as JSON, empty = none
+  std::string traceFileName; // Chrome trace of the frame loop, empty = none
+  std::string maskFileName; // Run length encoded masks of the matched pixels, empty = none
+  bool merge; // Concatenate the shard videos instead of processing
+  std::vector<std::string> mergeFileNames;
+};
+
+void printRunUsage(const char *programName);
+
+// Returns false and prints the reason if the arguments are not usable
+bool parseRunOptions(int argc, char **argv, Run_Options &options);
+
+// Narrows startFrame and endFrame to this shard, needs the frame count of the video
+bool resolveFrameRange(Run_Options &options, int frameCount);
+
+#endif /* RUN_OPTIONS_HPP */
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "stage_timing.hpp"
+
+using namespace std;
+
+bool stageTimingOn = false;
+
+// Written by the owning thread only, the atomics make the final read safe
+struct Stage_Histogram {
+  atomic<uint64_t> counts[TIMING_STAGE_COUNT][TIMING_BUCKETS];
+  atomic<int64_t> total[TIMING_STAGE_COUNT];
+  atomic<int64_t> maximum[TIMING_STAGE_COUNT];
+};
+
+// Histograms of all threads that ever recorded, kept until the report
+static mutex histogramMutex;
+static vector<unique_ptr<Stage_Histogram> > histograms;
+static thread_local Stage_Histogram *threadHistogram = NULL;
+
+// Summary of one stage over all threads, in ns
+struct Stage_Summary {
+  uint64_t count;
+  double mean;
+  int64_t p50;
+  int64_t p95;
+  int64_t p99;
+  int64_t maximum;
+};
+
+
+void enableStageTiming(bool enabled)
+{
+  stageTimingOn = enabled;
+}
+
+
+int64_t stageClock()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static Stage_Histogram *registerThreadHistogram()
+{
+  unique_ptr<Stage_Histogram> histogram(new Stage_Histogram);
+  for(int stage = 0; stage < TIMING_STAGE_COUNT; stage++)
+  {
+    for(int bucket = 0; bucket < TIMING_BUCKETS; bucket++)
+      histogram->counts[stage][bucket].store(0, memory_order_relaxed);
+    histogram->total[stage].store(0, memory_order_relaxed);
+    histogram->maximum[stage].store(0, memory_order_relaxed);
+  }
+
+  lock_guard<mutex> lock(histogramMutex);
+  histograms.push_back(move(histogram));
+  return histograms.back().get();
+}
+
+
+// Values below 2^TIMING_SUB_BUCKET_BITS get a bucket each, above every power
+// of two is split into 2^TIMING_SUB_BUCKET_BITS buckets
+static int bucketOfValue(uint64_t value)
+{
+  if(value < (1u << TIMING_SUB_BUCKET_BITS))
+    return (int) value;
+  int exponent = 63 - __builtin_clzll(value);
+  int subBucket = (int) (value >> (exponent - TIMING_SUB_BUCKET_BITS)) & ((1 << TIMING_SUB_BUCKET_BITS) - 1);
+  return ((exponent - TIMING_SUB_BUCKET_BITS + 1) << TIMING_SUB_BUCKET_BITS) + subBucket;
+}
+
+
+// Middle of the values that fall into the bucket
+static int64_t bucketValue(int bucket)
+{
+  if(bucket < (1 << TIMING_SUB_BUCKET_BITS))
+    return bucket;
+  int exponent = (bucket >> TIMING_SUB_BUCKET_BITS) + TIMING_SUB_BUCKET_BITS - 1;
+  int subBucket = bucket & ((1 << TIMING_SUB_BUCKET_BITS) - 1);
+  int shift = exponent - TIMING_SUB_BUCKET_BITS;
+  int64_t lower = (int64_t) ((1 << TIMING_SUB_BUCKET_BITS) + subBucket) << shift;
+  return lower + (((int64_t) 1 << shift) >> 1);
+}
+
+
+void recordStageTime(int stage, int64_t nanoseconds)
+{
+  Stage_Histogram *histogram = threadHistogram;
+  if(histogram == NULL)
+    histogram = threadHistogram = registerThreadHistogram();
+  if(nanoseconds < 0)
+    nanoseconds = 0;
+
+  // Only this thread writes, a plain load and store is enough
+  atomic<uint64_t> &count = histogram->counts[stage][bucketOfValue(nanoseconds)];
+  count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  histogram->total[stage].store(histogram->total[stage].load(memory_order_relaxed) + nanoseconds, memory_order_relaxed);
+  if(nanoseconds > histogram->maximum[stage].load(memory_order_relaxed))
+    histogram->maximum[stage].store(nanoseconds, memory_order_relaxed);
+}
+
+
+void recordStageSection(int stage, int64_t begin, int frameIndex)
+{
+  int64_t end = stageClock();
+  if(stageTimingOn)
+    recordStageTime(stage, end - begin);
+  if(frameTraceEnabled())
+    traceFrameEvent(timingStageName(stage), frameIndex, begin, end);
+}
+
+
+const char *timingStageName(int stage)
+{
+  static const char *names[TIMING_STAGE_COUNT] = {"decode", "pose", "projection", "matching", "drawing", "display", "encode"};
+  return names[stage];
+}
+
+
+static int64_t percentileOfBuckets(const vector<uint64_t> &counts, uint64_t count, double percentile, int64_t maximum)
+{
+  uint64_t rank = (uint64_t) (percentile * count + 0.999999);
+  if(rank < 1)
+    rank = 1;
+  uint64_t cumulative = 0;
+  for(int bucket = 0; bucket < TIMING_BUCKETS; bucket++)
+  {
+    cumulative += counts[bucket];
+    if(cumulative >= rank)
+      return min(bucketValue(bucket), maximum);
+  }
+  return maximum;
+}
+
+
+static void summarizeStages(Stage_Summary summary[TIMING_STAGE_COUNT])
+{
+  lock_guard<mutex> lock(histogramMutex);
+  for(int stage = 0; stage < TIMING_STAGE_COUNT; stage++)
+  {
+    vector<uint64_t> counts(TIMING_BUCKETS, 0);
+    uint64_t count = 0;
+    int64_t total = 0;
+    int64_t maximum = 0;
+    for(size_t histogramCounter = 0; histogramCounter < histograms.size(); histogramCounter++)
+    {
+      const Stage_Histogram &histogram = *histograms[histogramCounter];
+      for(int bucket = 0; bucket < TIMING_BUCKETS; bucket++)
+      {
+        uint64_t bucketCount = histogram.counts[stage][bucket].load(memory_order_relaxed);
+        counts[bucket] += bucketCount;
+        count += bucketCount;
+      }
+      total += histogram.total[stage].load(memory_order_relaxed);
+      maximum = max(maximum, histogram.maximum[stage].load(memory_order_relaxed));
+    }
+
+    summary[stage].count = count;
+    summary[stage].mean = (count > 0) ? (double) total / count : 0;
+    summary[stage].p50 = (count > 0) ? percentileOfBuckets(counts, count, 0.50, maximum) : 0;
+    summary[stage].p95 = (count > 0) ? percentileOfBuckets(counts, count, 0.95, maximum) : 0;
+    summary[stage].p99 = (count > 0) ? percentileOfBuckets(counts, count, 0.99, maximum) : 0;
+    summary[stage].maximum = maximum;
+  }
+}
+
+
+void printStageTimingReport()
+{
+  Stage_Summary summary[TIMING_STAGE_COUNT];
+  summarizeStages(summary);
+
+  ios::fmtflags flags = cout.flags();
+  streamsize precision = cout.precision();
+  cout << fixed << setprecision(3);
+  cout << "Stage timing in ms" << endl;
+  cout << left << setw(12) << "stage" << right << setw(10) << "count" << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p95" << setw(10) << "p99" << setw(10) << "max" << endl;
+  for(int stage = 0; stage < TIMING_STAGE_COUNT; stage++)
+  {
+    if(summary[stage].count == 0)
+      continue;
+    cout << left << setw(12) << timingStageName(stage) << right << setw(10) << summary[stage].count;
+    cout << setw(10) << summary[stage].mean / 1e6 << setw(10) << summary[stage].p50 / 1e6 << setw(10) << summary[stage].p95 / 1e6;
+    cout << setw(10) << summary[stage].p99 / 1e6 << setw(10) << summary[stage].maximum / 1e6 << endl;
+  }
+  cout.flags(flags);
+  cout.precision(precision);
+}
+
+
+bool writeStageTimingJson(const string &fileName)
+{
+  Stage_Summary summary[TIMING_STAGE_COUNT];
+  summarizeStages(summary);
+
+  ofstream file(fileName.c_str());
+  if(!file)
+  {
+    cout << "Could not write stage timing " << fileName << endl;
+    return false;
+  }
+
+  file << fixed << setprecision(6);
+  file << "{" << endl << "  \"unit\": \"ms\"," << endl << "  \"stages\": {";
+  bool first = true;
+  for(int stage = 0; stage < TIMING_STAGE_COUNT; stage++)
+  {
+    if(summary[stage].count == 0)
+      continue;
+    file << (first ? "" : ",") << endl;
+    file << "    \"" << timingStageName(stage) << "\": {\"count\": " << summary[stage].count;
+    file << ", \"mean\": " << summary[stage].mean / 1e6 << ", \"p50\": " << summary[stage].p50 / 1e6;
+    file << ", \"p95\": " << summary[stage].p95 / 1e6 << ", \"p99\": " << summary[stage].p99 / 1e6;
+    file << ", \"max\": " << summary[stage].maximum / 1e6 << "}";
+    first = false;
+  }
+  file << endl << "  }" << endl << "}" << endl;
+  return (bool) file;
+}
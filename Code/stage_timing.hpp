@@ -0,0 +1,68 @@
+#ifndef STAGE_TIMING_HPP
+#define STAGE_TIMING_HPP
+
+#include <stdint.h>
+#include <string>
+
+#include "frame_trace.hpp"
+
+#define TIMING_STAGE_DECODE 0
+#define TIMING_STAGE_POSE 1
+#define TIMING_STAGE_PROJECTION 2 // Ground positions of the pixels
+#define TIMING_STAGE_MATCHING 3 // Plan lookup of the positions
+#define TIMING_STAGE_DRAWING 4
+#define TIMING_STAGE_DISPLAY 5
+#define TIMING_STAGE_ENCODE 6 // Output video and stored frames
+#define TIMING_STAGE_COUNT 7
+
+// Sub buckets per power of two, the percentiles are within 1/16 of the value
+#define TIMING_SUB_BUCKET_BITS 4
+#define TIMING_BUCKETS ((64 - TIMING_SUB_BUCKET_BITS + 1) << TIMING_SUB_BUCKET_BITS)
+
+
+/********************/
+/*** Stage timing ***/
+/********************/
+// Every thread records into its own histograms, recording takes no lock and
+// no atomic read-modify-write. A thread registers its histograms once, the
+// first time it records. Switched off, recording is a single branch.
+extern bool stageTimingOn;
+
+// Has to be called before the threads start
+void enableStageTiming(bool enabled);
+
+inline bool stageTimingEnabled()
+{
+  return stageTimingOn;
+}
+
+// Monotonic clock in ns
+int64_t stageClock();
+
+// Start of a measurement, 0 if timing and tracing are off
+inline int64_t stageTimingBegin()
+{
+  return (stageTimingOn | frameTraceEnabled()) ? stageClock() : 0;
+}
+
+// Adds one sample of the given stage to the histogram of the calling thread
+void recordStageTime(int stage, int64_t nanoseconds);
+
+// Histogram sample and trace event of the section since begin
+void recordStageSection(int stage, int64_t begin, int frameIndex);
+
+// Nothing if timing and tracing are off, frameIndex -1 if not known
+inline void stageTimingEnd(int stage, int64_t begin, int frameIndex)
+{
+  if(stageTimingOn | frameTraceEnabled())
+    recordStageSection(stage, begin, frameIndex);
+}
+
+const char *timingStageName(int stage);
+
+// Count, mean, p50 / p95 / p99 and max of every stage over all threads.
+// Only call once the recording threads are done.
+void printStageTimingReport();
+bool writeStageTimingJson(const std::string &fileName);
+
+#endif /* STAGE_TIMING_HPP */
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gps_track.hpp"
+
+using namespace std;
+
+#define TRACK_CHECK_SAMPLES 200000
+#define TRACK_CHECK_MAX_SECONDS 5.0 // A loader that rescans the file per sample needs minutes
+#define TRACK_CHECK_FILE "track_load_check.gpx"
+
+
+static void printTrackCheckUsage(const char *programName)
+{
+  cout << "Usage: " << programName << " [--samples <n>] [--max-seconds <s>] [--file <gpx file>]" << endl;
+  cout << "  Writes a GPX track with <time> and <ele> children and times loadGpsTrack on it" << endl;
+  cout << "  Exits with 1 if loading takes longer than the limit or gives wrong samples" << endl;
+}
+
+
+// One sample per 0.1 s, every tenth point without a course so its heading is computed
+static bool writeTrackCheckGpx(const string &fileName, int sampleCount)
+{
+  FILE *file = fopen(fileName.c_str(), "w");
+  if(!file)
+  {
+    cout << "Could not write " << fileName << endl;
+    return false;
+  }
+  fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<gpx version=\"1.1\" creator=\"track_load_check\">\n<trk><trkseg>\n");
+  for(int sampleCounter = 0; sampleCounter < sampleCount; sampleCounter++)
+  {
+    int seconds = sampleCounter / 10;
+    fprintf(file, "  <trkpt lat=\"%.7f\" lon=\"%.7f\">\n", 48.378986 - sampleCounter * 1e-7, 16.825719 + sampleCounter * 5e-8);
+    fprintf(file, "    <ele>152.%d</ele>\n", sampleCounter % 10);
+    fprintf(file, "    <time>2019-05-14T%02d:%02d:%02d.%dZ</time>\n", seconds / 3600, (seconds / 60) % 60, seconds % 60, sampleCounter % 10);
+    if(sampleCounter % 10 != 0)
+      fprintf(file, "    <course>150</course>\n");
+    fprintf(file, "  </trkpt>\n");
+  }
+  fprintf(file, "</trkseg></trk>\n</gpx>\n");
+  return fclose(file) == 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  int sampleCount = TRACK_CHECK_SAMPLES;
+  double maxSeconds = TRACK_CHECK_MAX_SECONDS;
+  string fileName = TRACK_CHECK_FILE;
+  for(int argumentCounter = 1; argumentCounter < argc; argumentCounter++)
+  {
+    const char *argument = argv[argumentCounter];
+    if(strcmp(argument, "--samples") == 0 && argumentCounter + 1 < argc)
+      sampleCount = atoi(argv[++argumentCounter]);
+    else if(strcmp(argument, "--max-seconds") == 0 && argumentCounter + 1 < argc)
+      maxSeconds = atof(argv[++argumentCounter]);
+    else if(strcmp(argument, "--file") == 0 && argumentCounter + 1 < argc)
+      fileName = argv[++argumentCounter];
+    else
+    {
+      printTrackCheckUsage(argv[0]);
+      return -1;
+    }
+  }
+  if(sampleCount < 2 || sampleCount > 864000) // Times stay within one day
+  {
+    printTrackCheckUsage(argv[0]);
+    return -1;
+  }
+
+  if(!writeTrackCheckGpx(fileName, sampleCount))
+    return -1;
+
+  GPS_Track track;
+  chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+  bool loaded = loadGpsTrack(fileName, track);
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+  remove(fileName.c_str());
+
+  bool passed = loaded && ((int) track.samples.size() == sampleCount);
+  if(passed)
+  {
+    const Track_Sample &first = track.samples.front();
+    const Track_Sample &last = track.samples.back();
+    passed = (last.time - first.time > (sampleCount - 1) * 0.1 - 1e-3) && (last.time - first.time < (sampleCount - 1) * 0.1 + 1e-3)
+      && (track.samples[1].heading == 150) && (track.samples[0].heading != 150);
+  }
+  cout << fixed << setprecision(3);
+  cout << "GPX track of " << sampleCount << " samples loaded in " << seconds << " s, limit " << maxSeconds << " s" << endl;
+  if(!passed)
+  {
+    cout << "FAILED: " << (loaded ? to_string(track.samples.size()) : string("no")) << " samples or wrong times and headings" << endl;
+    return 1;
+  }
+  if(seconds > maxSeconds)
+  {
+    cout << "FAILED: loading is too slow" << endl;
+    return 1;
+  }
+  cout << "PASSED" << endl;
+  return 0;
+}
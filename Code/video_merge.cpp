@@ -0,0 +1,116 @@
+#include <iostream>
+#include <ctype.h>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "video_merge.hpp"
+
+using namespace std;
+using namespace cv;
+
+
+// FOURCC of the video stream, empty if the backend does not report it
+static string shardCodec(VideoCapture &shardVideo)
+{
+  int fourcc = (int) shardVideo.get(CAP_PROP_FOURCC);
+  string codec;
+  for(int charCounter = 0; charCounter < 4; charCounter++)
+    codec += (char) ((fourcc >> (8 * charCounter)) & 0xff);
+  for(size_t charCounter = 0; charCounter < codec.size(); charCounter++)
+  {
+    if(!isprint((unsigned char) codec[charCounter]))
+      return "";
+  }
+  return codec;
+}
+
+
+// Backends report the tag in either case, e.g. mp4v or MP4V
+static bool sameCodec(const string &first, const string &second)
+{
+  if(first.size() != second.size())
+    return false;
+  for(size_t charCounter = 0; charCounter < first.size(); charCounter++)
+  {
+    if(tolower((unsigned char) first[charCounter]) != tolower((unsigned char) second[charCounter]))
+      return false;
+  }
+  return true;
+}
+
+
+bool mergeShardVideos(const string &outputFileName, const vector<string> &shardFileNames, const string &requestedCodec)
+{
+  VideoWriter outputVideo;
+  Size frameSize;
+  string codec;
+  int totalFrames = 0;
+
+  for(size_t shardCounter = 0; shardCounter < shardFileNames.size(); shardCounter++)
+  {
+    VideoCapture shardVideo(shardFileNames[shardCounter]);
+    if(!shardVideo.isOpened())
+    {
+      cout << "Could not open shard video " << shardFileNames[shardCounter] << "!" << endl;
+      return false;
+    }
+
+    Size shardSize(shardVideo.get(CAP_PROP_FRAME_WIDTH), shardVideo.get(CAP_PROP_FRAME_HEIGHT));
+    string thisCodec = shardCodec(shardVideo);
+    if(!outputVideo.isOpened())
+    {
+      codec = thisCodec;
+      if(codec.empty() && requestedCodec.empty())
+      {
+        cout << "The codec of " << shardFileNames[shardCounter] << " is unknown, please give it with --codec!" << endl;
+        return false;
+      }
+      if(codec.empty())
+      {
+        cout << "The codec of " << shardFileNames[shardCounter] << " is unknown, assuming " << requestedCodec << endl;
+        codec = requestedCodec;
+      }
+      else if(!requestedCodec.empty() && !sameCodec(codec, requestedCodec))
+      {
+        cout << "The shards use the codec " << codec << ", not " << requestedCodec << ". Merging re-encodes, a different codec would not match a full run!" << endl;
+        return false;
+      }
+
+      double framesPerSecond = shardVideo.get(CAP_PROP_FPS);
+      if(framesPerSecond <= 0)
+        framesPerSecond = 30;
+      frameSize = shardSize;
+      outputVideo.open(outputFileName, VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]), framesPerSecond, frameSize, true);
+      if(!outputVideo.isOpened())
+      {
+        cout << "Could not open output video " << outputFileName << " with codec " << codec << "!" << endl;
+        return false;
+      }
+    }
+    else if(shardSize != frameSize)
+    {
+      cout << "Shard video " << shardFileNames[shardCounter] << " has a different frame size!" << endl;
+      return false;
+    }
+    else if(!thisCodec.empty() && !sameCodec(thisCodec, codec))
+    {
+      cout << "Shard video " << shardFileNames[shardCounter] << " has the codec " << thisCodec << ", the first shard " << codec << "!" << endl;
+      return false;
+    }
+
+    int shardFrames = 0;
+    Mat frame;
+    while(shardVideo.read(frame))
+    {
+      outputVideo.write(frame);
+      shardFrames++;
+    }
+    cout << "Merged " << shardFrames << " frames of " << shardFileNames[shardCounter] << endl;
+    totalFrames += shardFrames;
+  }
+
+  outputVideo.release();
+  cout << "Merged video " << outputFileName << ": " << totalFrames << " frames, re-encoded with " << codec << endl;
+  return true;
+}
@@ -0,0 +1,16 @@
+#ifndef VIDEO_MERGE_HPP
+#define VIDEO_MERGE_HPP
+
+#include <string>
+#include <vector>
+
+// Appends the frames of all shard videos, in the given order, to one output
+// video. VideoWriter can not append encoded packets, so the shards are
+// decoded and encoded again: with a lossy codec the merged video is one
+// generation behind the shards and not identical to a full run. The codec
+// is the one of the shards, all shards must have the same one. A given codec
+// has to match it, empty = take it from the shards. Frame size and rate are
+// taken from the first shard.
+bool mergeShardVideos(const std::string &outputFileName, const std::vector<std::string> &shardFileNames, const std::string &requestedCodec);
+
+#endif /* VIDEO_MERGE_HPP */